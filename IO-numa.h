@@ -27,12 +27,18 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <numaif.h>
+#include <numa.h>
 
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
+#include <pthread.h>
+#include <algorithm>
 #include "parallel.h"
 #include "quickSort.h"
+#include "polymer-numa-array.h"
 using namespace std;
 
 typedef pair<uintE,uintE> intPair;
@@ -537,8 +543,283 @@ wghGraph<vertex> readWghGraph(char* iFile, bool symmetric, bool binary) {
 }
 
 
+//*****BINARY CSR FORMAT*****
+// Version 1 layout, every section starts on a page boundary so the file can
+// be mmap'd and its edge arrays used in place by graph<vertex>:
+//   csrHeader
+//   out offsets : (n+1) long long
+//   out edges   : m intE
+//   in offsets  : (n+1) long long   (only with CSR_HAS_IN_EDGES)
+//   in edges    : in offsets[n] intE (only with CSR_HAS_IN_EDGES)
+
+#define CSR_MAGIC (0x5253434d594c4f50LL) // "POLYMCSR"
+#define CSR_VERSION (1)
+#define CSR_ALIGN (4096)
+
+#define CSR_HAS_IN_EDGES (1)
+#define CSR_EDGELONG (2)
+
+struct csrHeader {
+    long long magic;
+    int version;
+    int flags;
+    long long n;
+    long long m;
+    long long outOffsetsPos;
+    long long outEdgesPos;
+    long long inOffsetsPos;
+    long long inEdgesPos;
+    long long totalSize;
+};
+
+inline long long csrAlign(long long pos) {
+    return (pos + CSR_ALIGN - 1) / CSR_ALIGN * CSR_ALIGN;
+}
+
+inline bool isCSRFile(char *fileName) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+        return false;
+    long long magic = 0;
+    bool isCSR = (read(fd, (void *)&magic, sizeof(long long)) == sizeof(long long) && magic == CSR_MAGIC);
+    close(fd);
+    return isCSR;
+}
+
+// With useFakeDegree the node-local edges kept by graphFilter2Direction
+// (fake out/in degree) are written instead of the full adjacency.
+template <class vertex>
+void dumpGraphToCSR(graph<vertex> &GA, char *fileName, bool useFakeDegree=false) {
+    const intT n = GA.n;
+    bool hasIn = (sizeof(vertex) == sizeof(asymmetricVertex));
+    long long m = GA.m;
+    long long inM = GA.m;
+    if (useFakeDegree) {
+        m = inM = 0;
+        for (intT i = 0; i < n; i++) {
+            m += GA.V[i].getFakeDegree();
+            inM += GA.V[i].getFakeInDegree();
+        }
+    }
+
+    csrHeader header;
+    memset(&header, 0, sizeof(csrHeader));
+    header.magic = CSR_MAGIC;
+    header.version = CSR_VERSION;
+    header.flags = (hasIn ? CSR_HAS_IN_EDGES : 0) | (sizeof(intE) == 8 ? CSR_EDGELONG : 0);
+    header.n = n;
+    header.m = m;
+    header.outOffsetsPos = csrAlign(sizeof(csrHeader));
+    header.outEdgesPos = csrAlign(header.outOffsetsPos + (n + 1) * sizeof(long long));
+    header.totalSize = header.outEdgesPos + m * sizeof(intE);
+    if (hasIn) {
+        header.inOffsetsPos = csrAlign(header.totalSize);
+        header.inEdgesPos = csrAlign(header.inOffsetsPos + (n + 1) * sizeof(long long));
+        header.totalSize = header.inEdgesPos + inM * sizeof(intE);
+    }
+
+    int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+    if (fd < 0 || ftruncate(fd, header.totalSize) != 0) {
+        cout << "Unable to create file: " << fileName << endl;
+        abort();
+    }
+    char *base = (char *)mmap(NULL, header.totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        cout << "Unable to map file: " << fileName << endl;
+        abort();
+    }
+    close(fd);
+    memcpy(base, &header, sizeof(csrHeader));
+
+    long long *outOffsets = (long long *)(base + header.outOffsetsPos);
+    intE *outEdges = (intE *)(base + header.outEdgesPos);
+    {
+        parallel_for (intT i = 0; i < n; i++) outOffsets[i] = useFakeDegree ? GA.V[i].getFakeDegree() : GA.V[i].getOutDegree();
+    }
+    outOffsets[n] = sequence::plusScan(outOffsets, outOffsets, n);
+    {   parallel_for (intT i = 0; i < n; i++) {
+            intE *dst = outEdges + outOffsets[i];
+            intT d = outOffsets[i+1] - outOffsets[i];
+            for (intT j = 0; j < d; j++) dst[j] = GA.V[i].getOutNeighbor(j);
+        }
+    }
+
+    if (hasIn) {
+        long long *inOffsets = (long long *)(base + header.inOffsetsPos);
+        intE *inEdges = (intE *)(base + header.inEdgesPos);
+        {
+            parallel_for (intT i = 0; i < n; i++) inOffsets[i] = useFakeDegree ? GA.V[i].getFakeInDegree() : GA.V[i].getInDegree();
+        }
+        inOffsets[n] = sequence::plusScan(inOffsets, inOffsets, n);
+        {   parallel_for (intT i = 0; i < n; i++) {
+                intE *dst = inEdges + inOffsets[i];
+                intT d = inOffsets[i+1] - inOffsets[i];
+                for (intT j = 0; j < d; j++) dst[j] = GA.V[i].getInNeighbor(j);
+            }
+        }
+    }
+
+    munmap(base, header.totalSize);
+    printf("wrote csr n & m: %d %lld\n", n, m);
+}
+
+template <class vertex>
+void bindCSRToNodes(graph<vertex> &GA, int *sizeArr, int numOfNodes);
+
+// Maps a CSR file and points every vertex straight into the mapping, no edge
+// is copied.  The mapping is private and writable: passes that rewrite edges
+// in place (such as graphAllEdgeHasher) get copy-on-write pages, which the
+// shard's binding allocates on the shard's node, and the file is never
+// modified.  The edges are spread over the NUMA nodes in shards of about m /
+// nodes edges each (file order), see bindCSRToNodes.
+template <class vertex>
+graph<vertex> loadGraphFromCSR(char *fileName) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        cout << "Unable to open file: " << fileName << endl;
+        abort();
+    }
+    struct stat st;
+    fstat(fd, &st);
+    char *base = (char *)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        cout << "Unable to map file: " << fileName << endl;
+        abort();
+    }
+
+    csrHeader *header = (csrHeader *)base;
+    if (header->magic != CSR_MAGIC || header->version != CSR_VERSION || header->totalSize != st.st_size) {
+        cout << "Bad csr file" << endl;
+        abort();
+    }
+    if (((header->flags & CSR_EDGELONG) != 0) != (sizeof(intE) == 8)) {
+        cout << "csr file edge width does not match intE (EDGELONG)" << endl;
+        abort();
+    }
+    bool hasIn = (header->flags & CSR_HAS_IN_EDGES) != 0;
+    if (!hasIn && sizeof(vertex) == sizeof(asymmetricVertex)) {
+        cout << "csr file has no in-edges, load it as a symmetric graph" << endl;
+        abort();
+    }
+
+    const intT n = header->n;
+    const long long m = header->m;
+    long long *outOffsets = (long long *)(base + header->outOffsetsPos);
+    intE *outEdges = (intE *)(base + header->outEdgesPos);
+    long long *inOffsets = hasIn ? (long long *)(base + header->inOffsetsPos) : outOffsets;
+    intE *inEdges = hasIn ? (intE *)(base + header->inEdgesPos) : outEdges;
+
+    vertex *v = newA(vertex, n);
+    {   parallel_for (intT i = 0; i < n; i++) {
+            v[i].setOutDegree(outOffsets[i+1] - outOffsets[i]);
+            v[i].setOutNeighbors(outEdges + outOffsets[i]);
+            v[i].setInDegree(inOffsets[i+1] - inOffsets[i]);
+            v[i].setInNeighbors(inEdges + inOffsets[i]);
+        }
+    }
+
+    cout << "n = " << n << " m = " << m << endl;
+    graph<vertex> G(v, n, m);
+    G.mapped = (void *)base;
+    G.mappedSize = st.st_size;
+
+    // equal edge shards, vertex boundaries found by binary search on the offsets
+    int numOfNodes = numa_num_configured_nodes();
+    int sizeArr[numOfNodes];
+    intT rangeLow = 0;
+    for (int i = 0; i < numOfNodes; i++) {
+        long long target = (i == numOfNodes - 1) ? m : m / numOfNodes * (i + 1);
+        intT rangeHi = (intT)(std::lower_bound(outOffsets + rangeLow, outOffsets + n, target) - outOffsets);
+        sizeArr[i] = rangeHi - rangeLow;
+        rangeLow = rangeHi;
+    }
+    sizeArr[numOfNodes - 1] += n - rangeLow;
+    bindCSRToNodes(G, sizeArr, numOfNodes);
+    return G;
+}
+
+inline void bindBytesToNode(char *start, char *end, int node) {
+    long pageMask = ~((long)CSR_ALIGN - 1);
+    char *alignedStart = (char *)((long)start & pageMask);
+    char *alignedEnd = (char *)(((long)end + CSR_ALIGN - 1) & pageMask);
+    if (alignedEnd <= alignedStart)
+        return;
+    unsigned long nodeMask = 1UL << node;
+    mbind(alignedStart, alignedEnd - alignedStart, MPOL_BIND, &nodeMask, sizeof(nodeMask) * 8, MPOL_MF_MOVE);
+    madvise(alignedStart, alignedEnd - alignedStart, MADV_WILLNEED);
+}
+
+// Places the adjacency of vertices [rangeLow, rangeHi) (in file order) of a
+// mapped CSR graph on NUMA node `node`: resident pages are migrated and
+// copies made on write are allocated there.  Pages that are not cached yet
+// come from the node of the thread that faults them, so call this from a
+// thread already bound to `node` and it pre-faults the range itself.
+template <class vertex>
+void bindCSRShard(graph<vertex> &GA, intT rangeLow, intT rangeHi, int node) {
+    if (GA.mapped == NULL)
+        return;
+    char *base = (char *)GA.mapped;
+    csrHeader *header = (csrHeader *)base;
+    int numOfSec = (header->flags & CSR_HAS_IN_EDGES) ? 2 : 1;
+    for (int sec = 0; sec < numOfSec; sec++) {
+        long long *offsets = (long long *)(base + (sec == 0 ? header->outOffsetsPos : header->inOffsetsPos));
+        char *edges = base + (sec == 0 ? header->outEdgesPos : header->inEdgesPos);
+        char *start = edges + offsets[rangeLow] * sizeof(intE);
+        char *end = edges + offsets[rangeHi] * sizeof(intE);
+        bindBytesToNode(start, end, node);
+        long numOfPages = (end - start + CSR_ALIGN - 1) / CSR_ALIGN;
+        {   parallel_for (long i = 0; i < numOfPages; i++) {
+                volatile char touch = start[i * CSR_ALIGN];
+                (void)touch;
+            }
+        }
+    }
+}
+
+template <class vertex>
+struct CSRShardArg {
+    graph<vertex> *GA;
+    intT rangeLow;
+    intT rangeHi;
+    int node;
+};
+
+template <class vertex>
+void *bindCSRShardThread(void *arg) {
+    CSRShardArg<vertex> *my_arg = (CSRShardArg<vertex> *)arg;
+    numa_run_on_node(my_arg->node);
+    numa_set_preferred(my_arg->node);
+    bindCSRShard(*my_arg->GA, my_arg->rangeLow, my_arg->rangeHi, my_arg->node);
+    return NULL;
+}
+
+// Binds consecutive (file order) shards of sizeArr vertices to nodes
+// 0..numOfNodes-1, each from a thread running on its node, in parallel.
+template <class vertex>
+void bindCSRToNodes(graph<vertex> &GA, int *sizeArr, int numOfNodes) {
+    if (GA.mapped == NULL)
+        return;
+    pthread_t tids[numOfNodes];
+    CSRShardArg<vertex> args[numOfNodes];
+    intT rangeLow = 0;
+    for (int i = 0; i < numOfNodes; i++) {
+        args[i].GA = &GA;
+        args[i].rangeLow = rangeLow;
+        args[i].rangeHi = rangeLow + sizeArr[i];
+        args[i].node = i;
+        rangeLow += sizeArr[i];
+        pthread_create(&tids[i], NULL, bindCSRShardThread<vertex>, (void *)&args[i]);
+    }
+    for (int i = 0; i < numOfNodes; i++)
+        pthread_join(tids[i], NULL);
+}
+
 template <class vertex>
 graph<vertex> loadGraphFromBin(char *fileName) {
+    if (isCSRFile(fileName))
+        return loadGraphFromCSR<vertex>(fileName);
+
     int fd = open(fileName, O_RDONLY, S_IREAD);
     long long totalSize = 0;
     read(fd, (void *)&totalSize, sizeof(long long));
@@ -681,12 +962,46 @@ void dumpGraphToBin(graph<vertex> &graph, char *fileName) {
     }
 }
 
-template<class vertex>
-void dumpPartitionInfo(graph<vertex> &graph, char * fileName, intT *sizeArr, int numOfNodes) {
-    int fd = open(fileName, O_RDWR | O_CREAT, S_IWRITE | S_IREAD);
-    if ((write(fd, sizeArr, sizeof(int) * numOfNodes)) < 0)
-        abort();
+//*****PARTITIONED GRAPH FORMAT*****
+// A partitioned graph is persisted under a prefix so later runs can skip
+// graphAllEdgeHasher, partitionByDegree and graphFilter2Direction:
+//   <prefix>         partitionHeader, sizeArr, then (out, in) degree pairs
+//                    of every vertex, all in hashed (partitioned) order
+//   <prefix>.<node>  the local graph of node <node> in the CSR format above,
+//                    holding only its fake (node-local) out/in edges
+// The vertex hash is not stored: it is a pure function of n and the number
+// of nodes, so the application rebuilds the same Hash_F on load.
+
+#define PART_MAGIC (0x5452415052594c4fLL) // "OLYRPART"
+#define PART_VERSION (1)
+
+struct partitionHeader {
+    long long magic;
+    int version;
+    int numOfNodes;
+    long long n;
+    long long m;
+    long long sizeArrPos;
+    long long degreesPos;
+    long long totalSize;
+};
+
+inline bool partitionExists(char *prefix) {
+    int fd = open(prefix, O_RDONLY);
+    if (fd < 0)
+        return false;
+    long long magic = 0;
+    bool isPart = (read(fd, (void *)&magic, sizeof(long long)) == sizeof(long long) && magic == PART_MAGIC);
+    close(fd);
+    return isPart;
+}
 
+inline void shardFileName(char *buf, char *prefix, int node) {
+    sprintf(buf, "%s.%d", prefix, node);
+}
+
+template<class vertex>
+void dumpPartitionInfo(graph<vertex> &graph, char * fileName, int *sizeArr, int numOfNodes) {
     //check size arr
     intT numOfVert = 0;
     for (int i = 0; i < numOfNodes; i++) {
@@ -698,72 +1013,175 @@ void dumpPartitionInfo(graph<vertex> &graph, char * fileName, intT *sizeArr, int
         abort();
     }
 
-    long long totalSize = 0;
-    for (intT i = 0; i < graph.n; i++) {
-        totalSize += 2 * sizeof(intT);
+    partitionHeader header;
+    memset(&header, 0, sizeof(partitionHeader));
+    header.magic = PART_MAGIC;
+    header.version = PART_VERSION;
+    header.numOfNodes = numOfNodes;
+    header.n = graph.n;
+    header.m = graph.m;
+    header.sizeArrPos = sizeof(partitionHeader);
+    header.degreesPos = header.sizeArrPos + sizeof(int) * numOfNodes;
+    header.totalSize = header.degreesPos + 2 * sizeof(intT) * (long long)graph.n;
+
+    char *buf = (char *)malloc(header.totalSize);
+    memcpy(buf, &header, sizeof(partitionHeader));
+    memcpy(buf + header.sizeArrPos, sizeArr, sizeof(int) * numOfNodes);
+    intT *degrees = (intT *)(buf + header.degreesPos);
+    {   parallel_for (intT i = 0; i < graph.n; i++) {
+            degrees[2 * i] = graph.V[i].getOutDegree();
+            degrees[2 * i + 1] = graph.V[i].getInDegree();
+        }
     }
 
-    void *buf = (void *)malloc(totalSize);
-    char *ptr = (char *)buf;
-
-    for (intT i = 0; i < graph.n; i++) {
-        *(intT *)ptr = graph.V[i].getOutDegree();
-        ptr += sizeof(intT);
-
-        *(intT *)ptr = graph.V[i].getInDegree();
-        ptr += sizeof(intT);
+    int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+    if (fd < 0) {
+        cout << "Unable to create file: " << fileName << endl;
+        abort();
     }
-
     long long written = 0;
-    while (written < totalSize) {
-        long long sizeWritten = write(fd, (void *)((char *)buf + written), totalSize - written);
+    while (written < header.totalSize) {
+        long long sizeWritten = write(fd, (void *)(buf + written), header.totalSize - written);
         if (sizeWritten < 0) {
-            printf("oops\n");
+            cout << "Unable to write file: " << fileName << endl;
+            abort();
         }
         written += sizeWritten;
     }
+    close(fd);
+    free(buf);
 }
 
-template <class vertex>
-graph<vertex> loadPartitionFromFile(char *fileName, intT *sizeArr, intT numOfNodes) {
-    int fd = open(fileName, O_RDONLY, S_IREAD);
-    read(fd, (void *)sizeArr, sizeof(intT) * numOfNodes);
-
-    long long totalSize = 0;
-    for (int i = 0; i < numOfNodes; i++) {
-        totalSize += sizeArr[i];
+inline char *readPartitionFile(char *fileName, partitionHeader &header) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        cout << "Unable to open file: " << fileName << endl;
+        abort();
+    }
+    if (read(fd, (void *)&header, sizeof(partitionHeader)) != sizeof(partitionHeader) ||
+        header.magic != PART_MAGIC || header.version != PART_VERSION) {
+        cout << "Bad partition file" << endl;
+        abort();
     }
 
-    void *buf = (void *)malloc(totalSize * sizeof(intT) * 2);
-    printf("number of vert is: %ld %p\n", totalSize, buf);
-
-    long long readSize = 0;
-    while (readSize < totalSize) {
-        long long readOnce = read(fd, (void *)((char *)buf + readSize), totalSize - readSize);
+    char *buf = (char *)malloc(header.totalSize);
+    long long readSize = sizeof(partitionHeader);
+    while (readSize < header.totalSize) {
+        long long readOnce = pread(fd, (void *)(buf + readSize), header.totalSize - readSize, readSize);
+        if (readOnce <= 0) {
+            cout << "Unable to read file: " << fileName << endl;
+            abort();
+        }
         readSize += readOnce;
-        printf("read %ld, accum %ld\n", readOnce, readSize);
     }
+    close(fd);
+    return buf;
+}
 
-    const intT n = totalSize;
-    char *ptr = (char *)buf;
+// Fills sizeArr with the persisted shard sizes; the partition must have been
+// produced for the same number of nodes.
+inline void loadPartitionSizes(char *fileName, int *sizeArr, int numOfNodes) {
+    partitionHeader header;
+    char *buf = readPartitionFile(fileName, header);
+    if (header.numOfNodes != numOfNodes) {
+        printf("partition file is for %d nodes, running on %d\n", header.numOfNodes, numOfNodes);
+        abort();
+    }
+    memcpy(sizeArr, buf + header.sizeArrPos, sizeof(int) * numOfNodes);
+    free(buf);
+}
+
+// Returns a degree-only graph (no edges) in partitioned order.  The real
+// degrees are what the kernels read from the global vertex array; the edges
+// come from loadLocalGraph on each node.
+template <class vertex>
+graph<vertex> loadPartitionFromFile(char *fileName) {
+    partitionHeader header;
+    char *buf = readPartitionFile(fileName, header);
+
+    const intT n = header.n;
+    intT *degrees = (intT *)(buf + header.degreesPos);
 
     vertex *vertices = newA(vertex, n);
-    long long counter = 0;
-    long long inCounter = 0;
+    {   parallel_for (intT i = 0; i < n; i++) {
+            vertices[i].setOutDegree(degrees[2 * i]);
+            vertices[i].setInDegree(degrees[2 * i + 1]);
+            vertices[i].setOutNeighbors(NULL);
+            vertices[i].setInNeighbors(NULL);
+        }
+    }
 
-    for (intT i = 0; i < n; i++) {
-        intT outDeg = *(intT *)ptr;
-        ptr += sizeof(intT);
+    free(buf);
+    cout << "n = " << n << " m = " << header.m << endl;
+    return graph<vertex>(vertices, n, header.m);
+}
 
-        intT inDeg = *(intT *)ptr;
-        ptr += sizeof(intT);
+template <class vertex>
+void dumpLocalGraph(graph<vertex> &localGraph, char *prefix, int node) {
+    char fileName[strlen(prefix) + 16];
+    shardFileName(fileName, prefix, node);
+    dumpGraphToCSR(localGraph, fileName, true);
+}
 
-        vertices[i].setOutDegree(outDeg);
-        vertices[i].setInDegree(inDeg);
+// Node-local counterpart of graphFilter2Direction: must be called from a
+// thread already bound to `node`.  The shard is read (not mapped) into
+// node-local memory, huge pages when it fills one (allocGraphData), so the
+// edges end up on the reading node.
+template <class vertex>
+graph<vertex> loadLocalGraph(graph<vertex> &GA, char *prefix, int node) {
+    char fileName[strlen(prefix) + 16];
+    shardFileName(fileName, prefix, node);
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        cout << "Unable to open file: " << fileName << endl;
+        abort();
     }
+    struct stat st;
+    fstat(fd, &st);
+    const long long totalSize = st.st_size;
+    char *base = (char *)allocGraphData(totalSize);
+
+    const long long chunkSize = 1 << 22;
+    const long long numOfChunks = (totalSize + chunkSize - 1) / chunkSize;
+    {   parallel_for (long long c = 0; c < numOfChunks; c++) {
+            long long pos = c * chunkSize;
+            long long end = min(pos + chunkSize, totalSize);
+            while (pos < end) {
+                long long readOnce = pread(fd, (void *)(base + pos), end - pos, pos);
+                if (readOnce <= 0) {
+                    cout << "Unable to read file: " << fileName << endl;
+                    abort();
+                }
+                pos += readOnce;
+            }
+        }
+    }
+    close(fd);
 
-    free(buf);
-    return graph<vertex>(vertices, (intT)n, 0, NULL);
+    csrHeader *header = (csrHeader *)base;
+    if (header->magic != CSR_MAGIC || header->version != CSR_VERSION || header->totalSize != totalSize ||
+        header->n != GA.n || ((header->flags & CSR_EDGELONG) != 0) != (sizeof(intE) == 8)) {
+        printf("Bad local graph file for node %d: %s\n", node, fileName);
+        abort();
+    }
+    bool hasIn = (header->flags & CSR_HAS_IN_EDGES) != 0;
+    const intT n = GA.n;
+    long long *outOffsets = (long long *)(base + header->outOffsetsPos);
+    intE *outEdges = (intE *)(base + header->outEdgesPos);
+    long long *inOffsets = hasIn ? (long long *)(base + header->inOffsetsPos) : outOffsets;
+    intE *inEdges = hasIn ? (intE *)(base + header->inEdgesPos) : outEdges;
+
+    vertex *newVertexSet = (vertex *)numa_alloc_local(sizeof(vertex) * n);
+    {   parallel_for (intT i = 0; i < n; i++) {
+            newVertexSet[i].setOutDegree(GA.V[i].getOutDegree());
+            newVertexSet[i].setInDegree(GA.V[i].getInDegree());
+            newVertexSet[i].setFakeDegree(outOffsets[i+1] - outOffsets[i]);
+            newVertexSet[i].setFakeInDegree(inOffsets[i+1] - inOffsets[i]);
+            newVertexSet[i].setOutNeighbors(outEdges + outOffsets[i]);
+            newVertexSet[i].setInNeighbors(inEdges + inOffsets[i]);
+        }
+    }
+    return graph<vertex>(newVertexSet, GA.n, GA.m);
 }
 
 template <class vertex>
@@ -4,6 +4,12 @@
 #include <iostream>
 #include <pthread.h>
 #include <numa.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 template <class ET>
 inline void toggle(volatile ET *var) {
@@ -35,4 +41,281 @@ struct Custom_barrier {
 	}
     }
 };
+
+// Scalable barriers for the runtime.  Every variant is sense-reversing,
+// keeps each shared word on its own cache line and waits by spinning for
+// BARRIER_SPIN rounds before sleeping on a futex, so oversubscribed runs
+// do not burn the cores they wait for.  Threads call wait(id) with a dense
+// id in [0, count).
+//   Tree_barrier           combining tree of fan-in BARRIER_FANIN
+//   Dissemination_barrier  log2(count) rounds of pairwise flags, no hot spot
+//   Hierarchical_barrier   NUMA aware: a counter per node, dissemination
+//                          among the last arriver of each node, then a
+//                          node-local release flag
+
+#ifndef BARRIER_SPIN
+#define BARRIER_SPIN (1 << 10)
+#endif
+#define BARRIER_FANIN (4)
+#define BARRIER_LINE (64)
+
+inline void futexWait(volatile int *addr, int val) {
+    syscall(SYS_futex, (int *)addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+inline void futexWake(volatile int *addr) {
+    syscall(SYS_futex, (int *)addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+// a flag and the number of threads asleep on it, alone on a cache line
+struct Barrier_flag {
+    volatile int val;
+    volatile int sleepers;
+    char pad[BARRIER_LINE - 2 * sizeof(int)];
+
+    inline void waitWhileEq(int old) {
+	for (int i = 0; i < BARRIER_SPIN; i++) {
+	    if (val != old) {
+		__asm__ __volatile__ ("":::"memory");
+		return;
+	    }
+	    __asm__ __volatile__ ("pause\n\t":::"memory");
+	}
+	__sync_fetch_and_add(&sleepers, 1);
+	while (val == old)
+	    futexWait(&val, old);
+	__sync_fetch_and_sub(&sleepers, 1);
+    }
+
+    inline void set(int newVal) {
+	__asm__ __volatile__ ("":::"memory");
+	val = newVal;
+	__sync_synchronize();
+	if (sleepers > 0)
+	    futexWake(&val);
+    }
+} __attribute__((aligned(BARRIER_LINE)));
+
+struct Barrier_counter {
+    volatile int val;
+    char pad[BARRIER_LINE - sizeof(int)];
+} __attribute__((aligned(BARRIER_LINE)));
+
+template <class T>
+inline T *allocBarrierLines(int num) {
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, BARRIER_LINE, sizeof(T) * num) != 0)
+	return NULL;
+    memset(ptr, 0, sizeof(T) * num);
+    return (T *)ptr;
+}
+
+struct Tree_barrier {
+    int count;
+    int numOfNodes;
+    Barrier_counter *arrived;   // per tree node
+    int *expected;              // children of each tree node
+    int *parent;                // -1 at the root
+    Barrier_flag *release;
+    Barrier_counter *sense;     // per thread
+
+    Tree_barrier(int _count) : count(_count) {
+	// level sizes from the leaves up; node ids are assigned level by level
+	numOfNodes = 0;
+	for (int width = count; ; width = (width + BARRIER_FANIN - 1) / BARRIER_FANIN) {
+	    int nodes = (width + BARRIER_FANIN - 1) / BARRIER_FANIN;
+	    numOfNodes += nodes;
+	    if (nodes == 1)
+		break;
+	}
+	arrived = allocBarrierLines<Barrier_counter>(numOfNodes);
+	expected = (int *)calloc(numOfNodes, sizeof(int));
+	parent = (int *)malloc(sizeof(int) * numOfNodes);
+	int levelStart = 0;
+	for (int width = count; ; ) {
+	    int nodes = (width + BARRIER_FANIN - 1) / BARRIER_FANIN;
+	    for (int i = 0; i < nodes; i++) {
+		expected[levelStart + i] = (i == nodes - 1) ? width - i * BARRIER_FANIN : BARRIER_FANIN;
+		parent[levelStart + i] = (nodes == 1) ? -1 : levelStart + nodes + i / BARRIER_FANIN;
+	    }
+	    if (nodes == 1)
+		break;
+	    levelStart += nodes;
+	    width = nodes;
+	}
+	release = allocBarrierLines<Barrier_flag>(1);
+	sense = allocBarrierLines<Barrier_counter>(count);
+    }
+
+    ~Tree_barrier() {
+	free(arrived);
+	free(expected);
+	free(parent);
+	free(release);
+	free(sense);
+    }
+
+    inline void wait(int id) {
+	int mySense = 1 - sense[id].val;
+	sense[id].val = mySense;
+	int node = id / BARRIER_FANIN;
+	while (1) {
+	    if (__sync_add_and_fetch(&arrived[node].val, 1) < expected[node]) {
+		release->waitWhileEq(1 - mySense);
+		return;
+	    }
+	    arrived[node].val = 0;
+	    if (parent[node] == -1)
+		break;
+	    node = parent[node];
+	}
+	release->set(mySense);
+    }
+};
+
+struct Dissemination_barrier {
+    int count;
+    int rounds;
+    Barrier_flag *flags;        // [id][parity][round]
+    Barrier_counter *state;     // per thread: parity in bit 0, sense in bit 1
+
+    Dissemination_barrier(int _count) : count(_count) {
+	rounds = 0;
+	while ((1 << rounds) < count)
+	    rounds++;
+	flags = allocBarrierLines<Barrier_flag>(count * 2 * (rounds > 0 ? rounds : 1));
+	state = allocBarrierLines<Barrier_counter>(count);
+	for (int i = 0; i < count; i++)
+	    state[i].val = 2; // parity 0, sense 1
+    }
+
+    ~Dissemination_barrier() {
+	free(flags);
+	free(state);
+    }
+
+    inline Barrier_flag *flagOf(int id, int parity, int round) {
+	return &flags[(id * 2 + parity) * rounds + round];
+    }
+
+    inline void wait(int id) {
+	int parity = state[id].val & 1;
+	int sense = state[id].val >> 1;
+	for (int r = 0; r < rounds; r++) {
+	    int partner = (id + (1 << r)) % count;
+	    flagOf(partner, parity, r)->set(sense);
+	    flagOf(id, parity, r)->waitWhileEq(1 - sense);
+	}
+	if (parity == 1)
+	    sense = 1 - sense;
+	state[id].val = (1 - parity) | (sense << 1);
+    }
+};
+
+struct Hierarchical_barrier {
+    int numOfNodes;
+    int perNode;
+    Barrier_counter *arrived;   // per node
+    Barrier_flag *release;      // per node
+    Barrier_counter *sense;     // per thread
+    Dissemination_barrier *leaders;
+
+    Hierarchical_barrier(int _numOfNodes, int _perNode) : numOfNodes(_numOfNodes), perNode(_perNode) {
+	arrived = allocBarrierLines<Barrier_counter>(numOfNodes);
+	release = allocBarrierLines<Barrier_flag>(numOfNodes);
+	sense = allocBarrierLines<Barrier_counter>(numOfNodes * perNode);
+	leaders = new Dissemination_barrier(numOfNodes);
+    }
+
+    ~Hierarchical_barrier() {
+	free(arrived);
+	free(release);
+	free(sense);
+	delete leaders;
+    }
+
+    // id is node * perNode + core
+    inline void wait(int id) {
+	int node = id / perNode;
+	int mySense = 1 - sense[id].val;
+	sense[id].val = mySense;
+	if (__sync_add_and_fetch(&arrived[node].val, 1) < perNode) {
+	    release[node].waitWhileEq(1 - mySense);
+	    return;
+	}
+	arrived[node].val = 0;
+	leaders->wait(node);
+	release[node].set(mySense);
+    }
+};
+
+// one of the barriers above, or a pthread barrier, chosen at run time
+#define BARRIER_PTHREAD (0)
+#define BARRIER_TREE (1)
+#define BARRIER_DISSEMINATION (2)
+#define BARRIER_HIERARCHICAL (3)
+
+struct Polymer_barrier {
+    int kind;
+    pthread_barrier_t pthreadBarr;
+    Tree_barrier *tree;
+    Dissemination_barrier *dissemination;
+    Hierarchical_barrier *hierarchical;
+
+    Polymer_barrier(int _kind, int numOfNodes, int perNode) : kind(_kind), tree(NULL), dissemination(NULL), hierarchical(NULL) {
+	int count = numOfNodes * perNode;
+	switch (kind) {
+	case BARRIER_TREE:
+	    tree = new Tree_barrier(count);
+	    break;
+	case BARRIER_DISSEMINATION:
+	    dissemination = new Dissemination_barrier(count);
+	    break;
+	case BARRIER_HIERARCHICAL:
+	    hierarchical = new Hierarchical_barrier(numOfNodes, perNode);
+	    break;
+	default:
+	    kind = BARRIER_PTHREAD;
+	    pthread_barrier_init(&pthreadBarr, NULL, count);
+	}
+    }
+
+    ~Polymer_barrier() {
+	delete tree;
+	delete dissemination;
+	delete hierarchical;
+	if (kind == BARRIER_PTHREAD)
+	    pthread_barrier_destroy(&pthreadBarr);
+    }
+
+    inline void wait(int id) {
+	switch (kind) {
+	case BARRIER_TREE:
+	    tree->wait(id);
+	    break;
+	case BARRIER_DISSEMINATION:
+	    dissemination->wait(id);
+	    break;
+	case BARRIER_HIERARCHICAL:
+	    hierarchical->wait(id);
+	    break;
+	default:
+	    pthread_barrier_wait(&pthreadBarr);
+	}
+    }
+};
+
+// POLYMER_BARRIER=pthread|tree|dissemination|hierarchical, default hierarchical
+inline int barrierKindFromEnv() {
+    const char *env = getenv("POLYMER_BARRIER");
+    if (env == NULL)
+	return BARRIER_HIERARCHICAL;
+    if (strcmp(env, "pthread") == 0)
+	return BARRIER_PTHREAD;
+    if (strcmp(env, "tree") == 0)
+	return BARRIER_TREE;
+    if (strcmp(env, "dissemination") == 0)
+	return BARRIER_DISSEMINATION;
+    return BARRIER_HIERARCHICAL;
+}
 #endif
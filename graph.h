@@ -1,6 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include "parallel.h"
 using namespace std;
 
@@ -65,12 +66,19 @@ struct graph {
     intE* allocatedInplace;
     intE* inEdges;
     intT* flags;
+    void *mapped; // file mapping the edges live in (loadGraphFromCSR)
+    long long mappedSize;
     graph(vertex* VV, intT nn, uintT mm) 
-	: V(VV), n(nn), m(mm), allocatedInplace(NULL), flags(NULL) {}
+	: V(VV), n(nn), m(mm), allocatedInplace(NULL), inEdges(NULL), flags(NULL), mapped(NULL), mappedSize(0) {}
     graph(vertex* VV, intT nn, uintT mm, intE* ai, intE* _inEdges = NULL) 
-	: V(VV), n(nn), m(mm), allocatedInplace(ai), inEdges(_inEdges), flags(NULL) {}
+	: V(VV), n(nn), m(mm), allocatedInplace(ai), inEdges(_inEdges), flags(NULL), mapped(NULL), mappedSize(0) {}
     void del() {
 	if (flags != NULL) free(flags);
+	if (mapped != NULL) {
+	    munmap(mapped, mappedSize);
+	    free(V);
+	    return;
+	}
 	if (allocatedInplace == NULL) 
 	    for (intT i=0; i < n; i++) V[i].del();
 	else free(allocatedInplace);
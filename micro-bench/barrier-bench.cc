@@ -5,10 +5,30 @@
 #include <numa.h>
 #include <sys/time.h>
 #include "../custom-barrier.h"
+#include "../polymer-log.h"
+#include "../polymer-topology.h"
+
+// Compares the barriers on the live topology: one thread per CPU picked by
+// POLYMER_PIN, grouped by node, each variant waited ITERS times in a row.
+// usage: barrier-bench [nodes] [iterations]
+
+#define BENCH_PTHREAD_GLOBAL (0)
+#define BENCH_PTHREAD_HIER (1)
+#define BENCH_CUSTOM_GLOBAL (2)
+#define BENCH_CUSTOM_HIER (3)
+#define BENCH_TREE (4)
+#define BENCH_DISSEMINATION (5)
+#define BENCH_HIERARCHICAL (6)
+#define BENCH_NUM (7)
+
+const char *benchNames[BENCH_NUM] = {"pthread global", "pthread local+submaster", "custom global",
+				     "custom local+submaster", "tree", "dissemination", "hierarchical"};
 
-int socketIdx[8] = {0, 2, 3, 1, 5, 4, 6, 7};
 int numOfNode = 0;
 int CORES_PER_NODE = 0;
+int ITERS = 100000;
+
+NumaTopology *topo;
 
 volatile int global_counter = 0;
 volatile int global_toggle = 0;
@@ -16,147 +36,129 @@ volatile int global_toggle = 0;
 volatile int global_counter2 = 0;
 volatile int global_toggle2 = 0;
 
-Custom_barrier *barriers;
+volatile int *local_counters;
 
 pthread_barrier_t global_barr;
 pthread_barrier_t submaster_barr;
 pthread_barrier_t *local_barr_list;
 
-void printTime(int subTid, struct timeval startT, struct timeval endT) {
-    if (subTid != 0) {
-	return;
-    }
-    double timeStart = (double)startT.tv_usec;
-    double timeEnd = (double)endT.tv_usec;
-    double barrTime = timeEnd - timeStart;
-    printf("barrier time: %lf\n", barrTime);
-}
-
-void *threadSubFunc(void *arg) {
-    int subTid = *(int *)arg;
-    //printf("subTid: %d %d\n", subTid, subTid / CORES_PER_NODE);
-    pthread_barrier_t *local_barr = &local_barr_list[subTid / CORES_PER_NODE];
-    
-    Custom_barrier global_custom(&global_counter, &global_toggle, numOfNode * CORES_PER_NODE);
-    Custom_barrier submaster_custom(&global_counter2, &global_toggle2, numOfNode);
-    Custom_barrier local_custom = barriers[subTid];
-
-    pthread_barrier_wait(&global_barr); 
+Tree_barrier *tree;
+Dissemination_barrier *dissemination;
+Hierarchical_barrier *hierarchical;
 
-    if (subTid == 0) {
-	sleep(3);
-    }
+double benchTime[BENCH_NUM];
 
-    struct timeval startT, endT;
+double now() {
+    struct timeval t;
     struct timezone tz = {0, 0};
-    gettimeofday(&startT, &tz);
-    
-    pthread_barrier_wait(&global_barr);
-    
-    gettimeofday(&endT, &tz);
-    printTime(subTid, startT, endT);
-    
-    if (subTid == 0) {
-	sleep(3);
-    }
-
-    gettimeofday(&startT, &tz);
-    pthread_barrier_wait(local_barr);
-    if (subTid % CORES_PER_NODE == 0) {
-	pthread_barrier_wait(&submaster_barr);
-    }
-    pthread_barrier_wait(local_barr);
-    
-    gettimeofday(&endT, &tz);
-    printTime(subTid, startT, endT);
-
-    if (subTid == 0) {
-	sleep(3);
-    }
-
-    gettimeofday(&startT, &tz);
-    
-    global_custom.wait();
-    
-    gettimeofday(&endT, &tz);
-    printTime(subTid, startT, endT);
-
-    if (subTid == 0) {
-	sleep(3);
-    }
-
-    gettimeofday(&startT, &tz);
-    
-    local_custom.wait();
-    if (subTid % CORES_PER_NODE == 0) {
-	submaster_custom.wait();
-    }
-    local_custom.wait();
-    
-    gettimeofday(&endT, &tz);
-    printTime(subTid, startT, endT);
-    
-
-    return NULL;
+    gettimeofday(&t, &tz);
+    return (double)t.tv_sec + (double)t.tv_usec / 1000000.0;
 }
 
-void *threadFunc(void *arg) {
-    int tid = *(int *)arg;
-    int node = socketIdx[tid];
-    char nodeString[10];
-    sprintf(nodeString, "%d", tid);
-    printf("%d ok %s\n", tid, nodeString);
-    struct bitmask *nodemask = numa_parse_nodestring(nodeString);
-    numa_bind(nodemask);
-
-    pthread_barrier_wait(&submaster_barr);
-
-    pthread_barrier_init(&(local_barr_list[tid]), NULL, CORES_PER_NODE);
-
-    pthread_barrier_wait(&submaster_barr);
-
-    volatile int localCounter;
-    volatile int localToggle;
-
-    int sub_args[CORES_PER_NODE]; 
-    pthread_t tids[CORES_PER_NODE];
-    for (int i = 0; i < CORES_PER_NODE; i++) {
-	sub_args[i] = i + tid * CORES_PER_NODE;
-	Custom_barrier barr(&localCounter, &localToggle, CORES_PER_NODE);
-	barriers[sub_args[i]] = barr;
-	pthread_create(&tids[i], NULL, threadSubFunc, (void *)(&sub_args[i]));
+void *threadSubFunc(void *arg) {
+    int subTid = *(int *)arg;
+    int tid = subTid / CORES_PER_NODE;
+    int node = topo->nodeOf(tid);
+    if (node >= 0) {
+	char nodeString[10];
+	sprintf(nodeString, "%d", node);
+	struct bitmask *nodemask = numa_parse_nodestring(nodeString);
+	numa_bind(nodemask);
+	numa_bitmask_free(nodemask);
     }
-
-    for (int i = 0; i < CORES_PER_NODE; i++) {
-	pthread_join(tids[i], NULL);
+    int cpu = topo->cpuOf(tid, subTid % CORES_PER_NODE);
+    if (cpu >= 0) {
+	cpu_set_t pinSet;
+	CPU_ZERO(&pinSet);
+	CPU_SET(cpu, &pinSet);
+	pthread_setaffinity_np(pthread_self(), sizeof(pinSet), &pinSet);
     }
 
+    pthread_barrier_t *local_barr = &local_barr_list[tid];
+    Custom_barrier global_custom(&global_counter, &global_toggle, numOfNode * CORES_PER_NODE);
+    Custom_barrier submaster_custom(&global_counter2, &global_toggle2, numOfNode);
+    Custom_barrier local_custom(&local_counters[2 * tid], &local_counters[2 * tid + 1], CORES_PER_NODE);
+    bool isSubMaster = (subTid % CORES_PER_NODE == 0);
+
+    for (int b = 0; b < BENCH_NUM; b++) {
+	pthread_barrier_wait(&global_barr);
+	double startT = now();
+	for (int i = 0; i < ITERS; i++) {
+	    switch (b) {
+	    case BENCH_PTHREAD_GLOBAL:
+		pthread_barrier_wait(&global_barr);
+		break;
+	    case BENCH_PTHREAD_HIER:
+		pthread_barrier_wait(local_barr);
+		if (isSubMaster)
+		    pthread_barrier_wait(&submaster_barr);
+		pthread_barrier_wait(local_barr);
+		break;
+	    case BENCH_CUSTOM_GLOBAL:
+		global_custom.wait();
+		break;
+	    case BENCH_CUSTOM_HIER:
+		local_custom.wait();
+		if (isSubMaster)
+		    submaster_custom.wait();
+		local_custom.wait();
+		break;
+	    case BENCH_TREE:
+		tree->wait(subTid);
+		break;
+	    case BENCH_DISSEMINATION:
+		dissemination->wait(subTid);
+		break;
+	    case BENCH_HIERARCHICAL:
+		hierarchical->wait(subTid);
+		break;
+	    }
+	}
+	double endT = now();
+	pthread_barrier_wait(&global_barr);
+	if (subTid == 0)
+	    benchTime[b] = endT - startT;
+    }
     return NULL;
 }
 
 int main(int argc, char* argv[]) {
-    numOfNode = numa_num_configured_nodes();
-    CORES_PER_NODE = numa_num_configured_cpus() / numOfNode;
+    topo = new NumaTopology(pinPolicyFromEnv());
+    numOfNode = topo->numOfNode;
     if (argc > 1) {
 	numOfNode = atoi(argv[1]);
     }
+    if (argc > 2) {
+	ITERS = atoi(argv[2]);
+    }
+    CORES_PER_NODE = topo->minPinCount(numOfNode);
+    int numOfThreads = numOfNode * CORES_PER_NODE;
+    printf("%d nodes, %d threads per node, %d iterations\n", numOfNode, CORES_PER_NODE, ITERS);
 
-    pthread_barrier_init(&global_barr, NULL, numOfNode * CORES_PER_NODE);
+    pthread_barrier_init(&global_barr, NULL, numOfThreads);
     pthread_barrier_init(&submaster_barr, NULL, numOfNode);
     local_barr_list = (pthread_barrier_t *)malloc(sizeof(pthread_barrier_t) * numOfNode);
-    
-    barriers = (Custom_barrier *)malloc(sizeof(Custom_barrier) * numOfNode * CORES_PER_NODE);
-    
-    int args[numOfNode]; 
-    pthread_t tids[numOfNode];
-    for (int i = 0; i < numOfNode; i++) {
+    for (int i = 0; i < numOfNode; i++)
+	pthread_barrier_init(&local_barr_list[i], NULL, CORES_PER_NODE);
+    local_counters = (volatile int *)calloc(2 * numOfNode, sizeof(int));
+
+    tree = new Tree_barrier(numOfThreads);
+    dissemination = new Dissemination_barrier(numOfThreads);
+    hierarchical = new Hierarchical_barrier(numOfNode, CORES_PER_NODE);
+
+    int args[numOfThreads];
+    pthread_t tids[numOfThreads];
+    for (int i = 0; i < numOfThreads; i++) {
 	args[i] = i;
-	pthread_create(&tids[i], NULL, threadFunc, (void *)(&args[i]));
-	printf("%p %d\n", &args[i], args[i]);
+	pthread_create(&tids[i], NULL, threadSubFunc, (void *)(&args[i]));
     }
-    
-    for (int i = 0; i < numOfNode; i++) {
+
+    for (int i = 0; i < numOfThreads; i++) {
 	pthread_join(tids[i], NULL);
     }
+
+    for (int b = 0; b < BENCH_NUM; b++) {
+	printf("%-24s %10.1lf ns/barrier\n", benchNames[b], benchTime[b] * 1e9 / ITERS);
+    }
     return 0;
 }
@@ -22,6 +22,9 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
 #if defined(CILK)
 #include <cilk/cilk.h>
 #define parallel_main main
@@ -40,12 +43,44 @@
 // openmp
 #elif defined(OPENMP)
 #include <omp.h>
+#include <sched.h>
 #define cilk_spawn
 #define cilk_sync
 #define parallel_main main
-#define parallel_for _Pragma("omp parallel for") for
-#define parallel_for_1 _Pragma("omp parallel for schedule (static,1)") for
-#define parallel_for_256 _Pragma("omp parallel for schedule (static,256)") for
+
+// minimum number of iterations handed to a worker at once
+#ifndef PARALLEL_GRAIN
+#define PARALLEL_GRAIN 1024
+#endif
+
+#define parallel_for _Pragma("omp parallel for num_threads(parallel_workers()) schedule(guided, PARALLEL_GRAIN)") for
+#define parallel_for_1 _Pragma("omp parallel for num_threads(parallel_workers()) schedule(dynamic, 1)") for
+#define parallel_for_256 _Pragma("omp parallel for num_threads(parallel_workers()) schedule(dynamic, 256)") for
+#define cilk_for parallel_for
+
+// Every thread that opens a parallel_for gets its own team.  By default the
+// team is as wide as the caller's CPU affinity mask: a node thread that has
+// already called numa_bind() only sees the cores of its node, and the team
+// threads inherit that mask, so per-node work (graph filtering, frontier
+// packing, ...) stays on the node that owns the data.
+static __thread int __parallel_workers = 0;
+
+inline int parallel_workers() {
+    if (__parallel_workers <= 0) {
+        int maxT = omp_get_max_threads();
+        cpu_set_t mask;
+        int n = 0;
+        if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+            n = CPU_COUNT(&mask);
+        __parallel_workers = (n > 0 && n < maxT) ? n : maxT;
+    }
+    return __parallel_workers;
+}
+
+// override the team width of the calling thread, 0 re-reads the affinity mask
+inline void set_parallel_workers(int n) {
+    __parallel_workers = n;
+}
 
 // c++
 #else
@@ -59,6 +94,15 @@
 
 #endif
 
+#if defined(CILK) || defined(CILKP)
+#include <cilk/cilk_api.h>
+inline int parallel_workers() { return __cilkrts_get_nworkers(); }
+inline void set_parallel_workers(int n) {}
+#elif !defined(OPENMP)
+inline int parallel_workers() { return 1; }
+inline void set_parallel_workers(int n) {}
+#endif
+
 #include <limits.h>
 
 #if defined(LONG)
@@ -79,3 +123,5 @@ typedef unsigned long uintE;
 typedef int intE;
 typedef unsigned int uintE;
 #endif
+
+#endif // _PARALLEL_H
@@ -0,0 +1,62 @@
+/*
+ * This code is part of the project "NUMA-aware Graph-structured Analytics"
+ *
+ *
+ * Copyright (C) 2014 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University
+ *     All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * For more about this software, visit:
+ *
+ *     http://ipads.se.sjtu.edu.cn/projects/polymer.html
+ *
+ */
+
+// Compile time hints a functor can give the edgeMap kernels.  Most functors
+// have a cond() that always returns true, and some never read the frontier
+// edgeMap produces.  A functor says so with an empty typedef:
+//
+//   typedef void trivial_cond;   cond() is always true
+//   typedef void no_frontier;    the output frontier is never read
+//
+// The traits are constants, so the kernels instantiated for such a functor
+// lose the cond() tests and the writes into the output frontier.
+
+#ifndef _POLYMER_FUNCTOR_H
+#define _POLYMER_FUNCTOR_H
+
+#include "parallel.h"
+
+template <class F>
+struct FunctorTraits {
+    private:
+    typedef char yes;
+    typedef char (&no)[2];
+
+    template <class U> static yes trivialCond(typename U::trivial_cond *);
+    template <class U> static no trivialCond(...);
+    template <class U> static yes noFrontier(typename U::no_frontier *);
+    template <class U> static no noFrontier(...);
+
+    public:
+    static const bool hasCond = sizeof(trivialCond<F>(0)) != sizeof(yes);
+    static const bool producesFrontier = sizeof(noFrontier<F>(0)) != sizeof(yes);
+};
+
+template <class F>
+inline bool functorCond(F &f, intT v) {
+    return !FunctorTraits<F>::hasCond || f.cond(v);
+}
+
+#endif // _POLYMER_FUNCTOR_H
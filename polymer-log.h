@@ -0,0 +1,94 @@
+/*
+ * This code is part of the project "NUMA-aware Graph-structured Analytics"
+ *
+ *
+ * Copyright (C) 2014 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University
+ *     All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * For more about this software, visit:
+ *
+ *     http://ipads.se.sjtu.edu.cn/projects/polymer.html
+ *
+ */
+
+// Compile-time logging.  A message is compiled only when its level is at
+// or below POLYMER_LOG_LEVEL; below that the macro expands to nothing, so
+// the format arguments are never evaluated.  Enabled messages are further
+// filtered by POLYMER_LOG_CATEGORIES, a constant bit mask the compiler
+// folds away.  Both are set from the Makefile (LOG=, LOGCAT=):
+//
+//   make LOG=4                  trace everything
+//   make LOG=4 LOGCAT=0x2       trace edgeMap only
+//
+// Levels:
+//   ERROR  failed invariants ("oops")
+//   INFO   once-per-run progress (default)
+//   DEBUG  once-per-iteration decisions (dense/sparse switches, sizes)
+//   TRACE  function entry, per-thread and per-call chatter
+
+#ifndef _POLYMER_LOG_H
+#define _POLYMER_LOG_H
+
+#include <stdio.h>
+
+#define POLYMER_LOG_NONE (0)
+#define POLYMER_LOG_ERROR (1)
+#define POLYMER_LOG_INFO (2)
+#define POLYMER_LOG_DEBUG (3)
+#define POLYMER_LOG_TRACE (4)
+
+#ifndef POLYMER_LOG_LEVEL
+#define POLYMER_LOG_LEVEL POLYMER_LOG_INFO
+#endif
+
+// categories
+#define LOG_PART (0x1)      // hashing, partitioning, local graph construction
+#define LOG_EDGEMAP (0x2)   // edgeMap and its dense/sparse kernels
+#define LOG_VERTEXMAP (0x4) // vertexMap, vertexFilter, vertexCounter
+#define LOG_FRONTIER (0x8)  // frontier structures and conversions
+#define LOG_APP (0x10)      // application drivers and functors
+#define LOG_ALL (0xff)
+
+#ifndef POLYMER_LOG_CATEGORIES
+#define POLYMER_LOG_CATEGORIES LOG_ALL
+#endif
+
+#define POLYMER_LOG(cat, ...) do { if ((POLYMER_LOG_CATEGORIES) & (cat)) printf(__VA_ARGS__); } while (0)
+
+#if POLYMER_LOG_LEVEL >= POLYMER_LOG_ERROR
+#define POLYMER_ERROR(cat, ...) POLYMER_LOG(cat, __VA_ARGS__)
+#else
+#define POLYMER_ERROR(cat, ...) do {} while (0)
+#endif
+
+#if POLYMER_LOG_LEVEL >= POLYMER_LOG_INFO
+#define POLYMER_INFO(cat, ...) POLYMER_LOG(cat, __VA_ARGS__)
+#else
+#define POLYMER_INFO(cat, ...) do {} while (0)
+#endif
+
+#if POLYMER_LOG_LEVEL >= POLYMER_LOG_DEBUG
+#define POLYMER_DEBUG(cat, ...) POLYMER_LOG(cat, __VA_ARGS__)
+#else
+#define POLYMER_DEBUG(cat, ...) do {} while (0)
+#endif
+
+#if POLYMER_LOG_LEVEL >= POLYMER_LOG_TRACE
+#define POLYMER_TRACE(cat, ...) POLYMER_LOG(cat, __VA_ARGS__)
+#else
+#define POLYMER_TRACE(cat, ...) do {} while (0)
+#endif
+
+#endif // _POLYMER_LOG_H
@@ -0,0 +1,338 @@
+/*
+ * This code is part of the project "NUMA-aware Graph-structured Analytics"
+ *
+ *
+ * Copyright (C) 2014 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University
+ *     All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * For more about this software, visit:
+ *
+ *     http://ipads.se.sjtu.edu.cn/projects/polymer.html
+ *
+ */
+
+// Vertex data arrays distributed over the NUMA nodes, and the huge page
+// backed memory behind them and the local graphs.  An array is indexed by
+// global vertex id like a plain one; shard k, the sizeArr[k] elements after
+// the first k shards, is placed on node k.
+//
+// Placement is per page.  A page that straddles a shard boundary goes to
+// the shard owning its first byte, so shards whose sizes are whole pages of
+// elements (partitionByDegree's, for the element size it was given) are
+// placed exactly, and any other boundary costs at most one remote page.
+// Each shard is bound with numa_tonode_memory, then pre-faulted from a
+// thread running on its node, all shards in parallel.  Shards past the
+// machine's nodes are left unbound.
+//
+// Random neighbour lookups over multi-GB arrays miss the TLB on nearly
+// every access with 4 KB pages.  POLYMER_HUGEPAGE picks the backing:
+//   thp    (default) map aligned to 2 MB and madvise(MADV_HUGEPAGE)
+//   2m/1g  explicit MAP_HUGETLB pages of that size, falling back to thp
+//          when the hugetlb pool cannot supply them
+//   none   base pages only
+// The page in use is also the unit of placement, see dataPageSize: an
+// array only gets huge pages when every shard can fill one, so small
+// arrays keep their 4 KB granularity.
+//
+// POLYMER_VERIFY_PLACEMENT=1 checks every array after mapping it: each
+// page is looked up with move_pages and the pages found off their node are
+// reported.
+
+#ifndef _POLYMER_NUMA_ARRAY_H
+#define _POLYMER_NUMA_ARRAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <numaif.h>
+#include "polymer-log.h"
+
+#define PAGESIZE (4096)
+
+#define HUGEPAGE_NONE (0)
+#define HUGEPAGE_THP (1)
+#define HUGEPAGE_2M (2)
+#define HUGEPAGE_1G (3)
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT (26)
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+struct HugePageConfig {
+    int mode;
+    size_t size;    // bytes of one huge page
+};
+
+inline HugePageConfig readHugePageConfig() {
+    HugePageConfig c;
+    c.mode = HUGEPAGE_THP;
+    const char *env = getenv("POLYMER_HUGEPAGE");
+    if (env != NULL) {
+        if (strcmp(env, "none") == 0)
+            c.mode = HUGEPAGE_NONE;
+        else if (strcmp(env, "2m") == 0)
+            c.mode = HUGEPAGE_2M;
+        else if (strcmp(env, "1g") == 0)
+            c.mode = HUGEPAGE_1G;
+    }
+    c.size = (c.mode == HUGEPAGE_1G) ? (1UL << 30) : (1UL << 21);
+    return c;
+}
+
+inline const HugePageConfig &hugePageConfig() {
+    static HugePageConfig config = readHugePageConfig();
+    return config;
+}
+
+// Page size, and unit of placement, of an array of `bytes` split in
+// numOfShards shards.  The partitioner sizes its blocks with it too.
+inline size_t dataPageSize(size_t bytes, int numOfShards) {
+    const HugePageConfig &c = hugePageConfig();
+    if (c.mode == HUGEPAGE_NONE || bytes < c.size * numOfShards)
+        return PAGESIZE;
+    return c.size;
+}
+
+inline size_t roundUpToPage(size_t bytes, size_t pageSize = PAGESIZE) {
+    return (bytes + pageSize - 1) / pageSize * pageSize;
+}
+
+// Maps `bytes` rounded up to pageSize, aligned to pageSize.  Huge pages
+// come from MAP_HUGETLB when asked for explicitly, else (or when the pool
+// is empty) from transparent huge pages on an aligned anonymous mapping.
+inline void *mapHugeData(size_t bytes, size_t pageSize) {
+    bytes = roundUpToPage(bytes > 0 ? bytes : 1, pageSize);
+    const HugePageConfig &c = hugePageConfig();
+    if (pageSize > PAGESIZE && c.mode >= HUGEPAGE_2M) {
+        int sizeFlag = (c.mode == HUGEPAGE_1G) ? MAP_HUGE_1GB : MAP_HUGE_2MB;
+        void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | sizeFlag, -1, 0);
+        if (p != MAP_FAILED)
+            return p;
+        static bool warned = false;
+        if (!warned) {
+            warned = true;
+            POLYMER_INFO(LOG_PART, "Polymer - no %s hugetlb pages, falling back to transparent huge pages\n", c.mode == HUGEPAGE_1G ? "1 GB" : "2 MB");
+        }
+    }
+
+    size_t extra = (pageSize > PAGESIZE) ? pageSize : 0;
+    char *p = (char *)mmap(NULL, bytes + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    if (extra == 0)
+        return p;
+    char *aligned = (char *)roundUpToPage((size_t)p, pageSize);
+    if (aligned > p)
+        munmap(p, aligned - p);
+    if (aligned + bytes < p + bytes + extra)
+        munmap(aligned + bytes, (p + bytes + extra) - (aligned + bytes));
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, bytes, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+
+inline void unmapHugeData(void *p, size_t bytes, size_t pageSize) {
+    munmap(p, roundUpToPage(bytes > 0 ? bytes : 1, pageSize));
+}
+
+// Edge and local vertex arrays of the local graphs: numa_alloc_local (node
+// -1) or numa_alloc_onnode, on huge pages when the array fills one.
+inline void *allocGraphData(size_t bytes, int node = -1) {
+    size_t pageSize = dataPageSize(bytes, 1);
+    if (pageSize == PAGESIZE)
+        return (node < 0) ? numa_alloc_local(bytes) : numa_alloc_onnode(bytes, node);
+    void *p = mapHugeData(bytes, pageSize);
+    if (p == NULL) {
+        POLYMER_ERROR(LOG_PART, "Polymer - allocGraphData - mmap of %lld bytes failed\n", (long long)bytes);
+        abort();
+    }
+    if (node < 0)
+        numa_setlocal_memory(p, roundUpToPage(bytes, pageSize));
+    else if (node <= numa_max_node())
+        numa_tonode_memory(p, roundUpToPage(bytes, pageSize), node);
+    return p;
+}
+
+inline void freeGraphData(void *p, size_t bytes) {
+    unmapHugeData(p, bytes, dataPageSize(bytes, 1));
+}
+
+struct DataArrayShard {
+    char *begin;
+    char *end;
+    int node;   // -1 leaves the shard unbound
+};
+
+inline size_t dataArrayBytes(int numOfShards, int *sizeArr, int sizeOfOneEle) {
+    size_t bytes = 0;
+    for (int i = 0; i < numOfShards; i++)
+        bytes += (size_t)sizeArr[i] * sizeOfOneEle;
+    return bytes;
+}
+
+// page range of every shard, see the comment on top
+inline void dataArrayShards(void *base, int numOfShards, int *sizeArr, int sizeOfOneEle, DataArrayShard *shards) {
+    int maxNode = numa_available() < 0 ? -1 : numa_max_node();
+    size_t pageSize = dataPageSize(dataArrayBytes(numOfShards, sizeArr, sizeOfOneEle), numOfShards);
+    size_t offset = 0;
+    for (int i = 0; i < numOfShards; i++) {
+        shards[i].begin = (char *)base + roundUpToPage(offset, pageSize);
+        offset += (size_t)sizeArr[i] * sizeOfOneEle;
+        shards[i].end = (char *)base + roundUpToPage(offset, pageSize);
+        shards[i].node = (i <= maxNode) ? i : -1;
+    }
+}
+
+inline void *prefaultDataArrayShard(void *arg) {
+    DataArrayShard *shard = (DataArrayShard *)arg;
+    if (shard->node >= 0)
+        numa_run_on_node(shard->node);
+    for (volatile char *p = shard->begin; p < shard->end; p += PAGESIZE)
+        *p = 0;
+    return NULL;
+}
+
+// pages of the array that are not on their shard's node, or not faulted
+inline long long verifyDataArray(void *base, int numOfShards, int *sizeArr, int sizeOfOneEle) {
+    DataArrayShard *shards = (DataArrayShard *)malloc(sizeof(DataArrayShard) * numOfShards);
+    dataArrayShards(base, numOfShards, sizeArr, sizeOfOneEle, shards);
+    long long misplaced = 0;
+    long long total = 0;
+    for (int i = 0; i < numOfShards; i++) {
+        if (shards[i].node < 0 || shards[i].end == shards[i].begin)
+            continue;
+        unsigned long count = (shards[i].end - shards[i].begin) / PAGESIZE;
+        void **pages = (void **)malloc(sizeof(void *) * count);
+        int *status = (int *)malloc(sizeof(int) * count);
+        for (unsigned long p = 0; p < count; p++)
+            pages[p] = shards[i].begin + p * PAGESIZE;
+        long long wrong = 0;
+        if (numa_move_pages(0, count, pages, NULL, status, 0) != 0) {
+            wrong = count;
+        } else {
+            for (unsigned long p = 0; p < count; p++)
+                if (status[p] != shards[i].node)
+                    wrong++;
+        }
+        POLYMER_DEBUG(LOG_PART, "Polymer - shard %d: %lld of %lu pages off node %d\n", i, wrong, count, shards[i].node);
+        misplaced += wrong;
+        total += count;
+        free(status);
+        free(pages);
+    }
+    POLYMER_INFO(LOG_PART, "Polymer - placement: %lld of %lld pages misplaced\n", misplaced, total);
+    free(shards);
+    return misplaced;
+}
+
+inline bool verifyPlacementFromEnv() {
+    const char *env = getenv("POLYMER_VERIFY_PLACEMENT");
+    return env != NULL && atoi(env) != 0;
+}
+
+// Maps an array of numOfShards shards, shard i holding sizeArr[i] elements
+// of sizeOfOneEle bytes, placed and pre-faulted as described on top.
+inline void *mapDataArray(int numOfShards, int *sizeArr, int sizeOfOneEle) {
+    POLYMER_TRACE(LOG_PART, "Polymer - mapDataArray\n");
+
+    size_t bytes = dataArrayBytes(numOfShards, sizeArr, sizeOfOneEle);
+    size_t pageSize = dataPageSize(bytes, numOfShards);
+    POLYMER_TRACE(LOG_PART, "Polymer - mapDataArray - Number of Pages = %lld of %lld bytes\n",
+                  (long long)(roundUpToPage(bytes > 0 ? bytes : 1, pageSize) / pageSize), (long long)pageSize);
+
+    void *base = mapHugeData(bytes, pageSize);
+    if (base == NULL) {
+        POLYMER_ERROR(LOG_PART, "Polymer - mapDataArray - mmap of %lld bytes failed\n", (long long)bytes);
+        abort();
+    }
+
+    DataArrayShard *shards = (DataArrayShard *)malloc(sizeof(DataArrayShard) * numOfShards);
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * numOfShards);
+    dataArrayShards(base, numOfShards, sizeArr, sizeOfOneEle, shards);
+    for (int i = 0; i < numOfShards; i++) {
+        POLYMER_TRACE(LOG_PART, "Polymer - mapDataArray - shard %d: %p to %p on node %d\n", i, shards[i].begin, shards[i].end, shards[i].node);
+        if (shards[i].node >= 0 && shards[i].end > shards[i].begin)
+            numa_tonode_memory(shards[i].begin, shards[i].end - shards[i].begin, shards[i].node);
+    }
+    for (int i = 0; i < numOfShards; i++)
+        pthread_create(&threads[i], NULL, prefaultDataArrayShard, (void *)&shards[i]);
+    for (int i = 0; i < numOfShards; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    free(shards);
+
+    if (verifyPlacementFromEnv())
+        verifyDataArray(base, numOfShards, sizeArr, sizeOfOneEle);
+    return base;
+}
+
+inline void unmapDataArray(void *base, int numOfShards, int *sizeArr, int sizeOfOneEle) {
+    size_t bytes = dataArrayBytes(numOfShards, sizeArr, sizeOfOneEle);
+    unmapHugeData(base, bytes, dataPageSize(bytes, numOfShards));
+}
+
+// Typed handle on a mapped data array.  It converts to T * so kernels and
+// functors keep taking plain pointers; the handle keeps the shard sizes
+// for verifyPlacement and release.
+template <class T>
+struct NumaArray {
+    T *ptr;
+    int numOfShards;
+    int *sizeArr;
+
+    NumaArray() : ptr(NULL), numOfShards(0), sizeArr(NULL) {}
+
+    void alloc(int _numOfShards, int *_sizeArr) {
+        numOfShards = _numOfShards;
+        sizeArr = (int *)malloc(sizeof(int) * numOfShards);
+        for (int i = 0; i < numOfShards; i++)
+            sizeArr[i] = _sizeArr[i];
+        ptr = (T *)mapDataArray(numOfShards, sizeArr, sizeof(T));
+    }
+
+    // pages off their node, see verifyDataArray
+    long long verifyPlacement() {
+        return verifyDataArray(ptr, numOfShards, sizeArr, sizeof(T));
+    }
+
+    void release() {
+        if (ptr == NULL)
+            return;
+        unmapDataArray(ptr, numOfShards, sizeArr, sizeof(T));
+        free(sizeArr);
+        ptr = NULL;
+        sizeArr = NULL;
+    }
+
+    inline T *data() const {
+        return ptr;
+    }
+
+    inline operator T *() const {
+        return ptr;
+    }
+};
+
+#endif // _POLYMER_NUMA_ARRAY_H
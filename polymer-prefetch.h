@@ -0,0 +1,168 @@
+/*
+ * This code is part of the project "NUMA-aware Graph-structured Analytics"
+ *
+ *
+ * Copyright (C) 2014 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University
+ *     All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * For more about this software, visit:
+ *
+ *     http://ipads.se.sjtu.edu.cn/projects/polymer.html
+ *
+ */
+
+// Software prefetching for the dense edge traversals.  A pull loop reads
+// the data of random sources and a push loop writes the data of random
+// destinations, each known only when its adjacency list entry is reached:
+// too late to hide a remote access, and invisible to the hardware
+// prefetcher, which only follows the sequential adjacency lists.  An
+// EdgePrefetcher walks the same adjacency lists a fixed number of edges
+// ahead of the traversal, across vertex boundaries, and prefetches the
+// functor's nextPrefetchAddr() of every neighbour it passes.
+//
+// POLYMER_PREFETCH sets the distance in edges (default 16, 0 disables
+// prefetching).  POLYMER_PREFETCH_LOCALITY sets the temporal locality hint,
+// from 0 (use once) to 3 (keep in every cache level, the default).
+//
+// The sparse kernels interleave the frontier vertices in groups instead,
+// see edgeMapSparseInterleaved.  POLYMER_SPARSE_GROUP sets the group size
+// (default 8, at most SPARSE_GROUP_MAX, 1 runs the vertices one by one).
+
+#ifndef _POLYMER_PREFETCH_H
+#define _POLYMER_PREFETCH_H
+
+#include <stdlib.h>
+#include "parallel.h"
+
+#define PREFETCH_DEFAULT_DISTANCE (16)
+#define PREFETCH_DEFAULT_LOCALITY (3)
+#define SPARSE_GROUP_DEFAULT (8)
+#define SPARSE_GROUP_MAX (32)
+
+struct PrefetchConfig {
+    intT distance;
+    int locality;
+    int sparseGroup;
+};
+
+inline PrefetchConfig readPrefetchConfig() {
+    PrefetchConfig c;
+    c.distance = PREFETCH_DEFAULT_DISTANCE;
+    c.locality = PREFETCH_DEFAULT_LOCALITY;
+    c.sparseGroup = SPARSE_GROUP_DEFAULT;
+    const char *env = getenv("POLYMER_PREFETCH");
+    if (env != NULL && atoi(env) >= 0)
+        c.distance = atoi(env);
+    env = getenv("POLYMER_PREFETCH_LOCALITY");
+    if (env != NULL && atoi(env) >= 0 && atoi(env) <= 3)
+        c.locality = atoi(env);
+    env = getenv("POLYMER_SPARSE_GROUP");
+    if (env != NULL && atoi(env) >= 1)
+        c.sparseGroup = (atoi(env) < SPARSE_GROUP_MAX) ? atoi(env) : SPARSE_GROUP_MAX;
+    return c;
+}
+
+inline const PrefetchConfig &prefetchConfig() {
+    static PrefetchConfig config = readPrefetchConfig();
+    return config;
+}
+
+// __builtin_prefetch wants its hints as constants
+template <int write>
+inline void prefetchWithLocality(const void *addr, int locality) {
+    switch (locality) {
+    case 0: __builtin_prefetch(addr, write, 0); break;
+    case 1: __builtin_prefetch(addr, write, 1); break;
+    case 2: __builtin_prefetch(addr, write, 2); break;
+    default: __builtin_prefetch(addr, write, 3); break;
+    }
+}
+
+// Lookahead over the in-edges (pull) or out-edges (push) of the vertices
+// [start, end) of G.  The traversal calls startVertex(i) before the edges of
+// vertex i and edge() after each edge; the lookahead catches up when the
+// traversal skips ahead of it.  Edges of the vertices the traversal skips,
+// or leaves early, were prefetched for nothing and no longer count towards
+// the distance.
+template <class vertex, class F, bool pull>
+struct EdgePrefetcher {
+    vertex *G;
+    F &f;
+    intT distance;
+    int locality;
+    intT end;
+    intT v, j, d; // next edge to prefetch, j of the d edges of v
+    intT lead;    // edges prefetched ahead of the traversal
+    intT cur, done; // vertex of the traversal, edges of it traversed
+
+    EdgePrefetcher(vertex *_G, F &_f, intT start, intT _end) :
+        G(_G), f(_f), distance(prefetchConfig().distance), locality(prefetchConfig().locality),
+        end(_end), v(start), j(0), d(0), lead(0), cur(start), done(0) {
+        if (v < end)
+            d = degree(v);
+    }
+
+    inline intT degree(intT u) {
+        return pull ? G[u].getFakeInDegree() : G[u].getFakeDegree();
+    }
+
+    inline void advance() {
+        while (j >= d) {
+            if (++v >= end)
+                return;
+            j = 0;
+            d = degree(v);
+        }
+        intT ngh = pull ? G[v].getInNeighbor(j) : G[v].getOutNeighbor(j);
+        prefetchWithLocality<pull ? 0 : 1>(f.nextPrefetchAddr(ngh), locality);
+        j++;
+        lead++;
+    }
+
+    inline void startVertex(intT i) {
+        if (distance == 0)
+            return;
+        if (v < i) {
+            v = i;
+            j = 0;
+            d = degree(v);
+            lead = 0;
+        } else if (cur < i) {
+            // everything before v is prefetched, so the rest of cur and
+            // the vertices up to i were passed over
+            lead -= degree(cur) - done;
+            for (intT u = cur + 1; u < i; u++)
+                lead -= degree(u);
+            if (lead < 0)
+                lead = 0;
+        }
+        cur = i;
+        done = 0;
+        while (lead < distance && v < end)
+            advance();
+    }
+
+    inline void edge() {
+        if (distance == 0)
+            return;
+        done++;
+        if (lead > 0)
+            lead--;
+        if (v < end)
+            advance();
+    }
+};
+
+#endif // _POLYMER_PREFETCH_H
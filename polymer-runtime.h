@@ -0,0 +1,249 @@
+/*
+ * This code is part of the project "NUMA-aware Graph-structured Analytics"
+ *
+ *
+ * Copyright (C) 2014 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University
+ *     All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * For more about this software, visit:
+ *
+ *     http://ipads.se.sjtu.edu.cn/projects/polymer.html
+ *
+ */
+
+// Persistent NUMA worker pool shared by the applications.
+//
+// PolymerRuntime discovers the nodes and cores (polymer-topology.h), starts
+// one thread per core bound to its node and pinned to a CPU of it, and gives every thread a ready Subworker_Partitioner
+// (tid = node, subTid = core in node) whose barriers are already wired:
+//   local_barr / local_custom       the cores of one node
+//   leader_barr / subMaster_custom  the sub masters (subTid 0) of all nodes
+//   global_barr / global_sync       every worker; globalWait() uses the
+//                                   POLYMER_BARRIER kind (custom-barrier.h)
+// Applications hand kernels of type
+//   void kernel(void *arg, Subworker_Partitioner &subworker)
+// to run() (every worker) or runNodes() (sub masters only, for per-node
+// setup such as building the local graph and frontier).  Both return once
+// the kernel finished on every participating thread; the threads persist
+// between calls until stop().
+//
+// The pinning policy comes from POLYMER_PIN (core, thread or none, see
+// polymer-topology.h).  Node kernels run with the whole node as affinity so
+// their parallel loops can use every core of it.
+//
+// Included from polymer.h and polymer-wgh.h after Subworker_Partitioner.
+
+#ifndef _POLYMER_RUNTIME_H
+#define _POLYMER_RUNTIME_H
+
+#include <pthread.h>
+#include <numa.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include "polymer-topology.h"
+
+typedef void (*polymer_kernel)(void *arg, Subworker_Partitioner &subworker);
+
+struct PolymerRuntime;
+
+struct Runtime_worker_arg {
+    PolymerRuntime *rt;
+    int tid;
+    int subTid;
+};
+
+inline void *polymerRuntimeWorker(void *arg);
+
+struct PolymerRuntime {
+    int numOfNode;
+    int coresPerNode;
+    int numOfWorkers;
+    NumaTopology *topo;
+
+    pthread_barrier_t leaderBarr;
+    pthread_barrier_t globalBarr;
+    pthread_barrier_t *localBarrs;
+    pthread_barrier_t startBarr;
+    pthread_barrier_t doneBarr;
+    Polymer_barrier *globalSync;
+
+    volatile int leaderCounter;
+    volatile int leaderToggle;
+    volatile int *localCounters; // counter and toggle of node i at [2 * i]
+
+    Subworker_Partitioner *subworkers;
+    Runtime_worker_arg *workerArgs;
+    pthread_t *threads;
+    bool started;
+
+    polymer_kernel kernel;
+    void *kernelArg;
+    bool nodesOnly;
+    volatile bool stopping;
+
+    // nodeUsed / coresUsed of -1 take the machine's values, pinPolicy of -1
+    // reads POLYMER_PIN
+    PolymerRuntime(int nodeUsed = -1, int coresUsed = -1, int pinPolicy = -1) : started(false), stopping(false) {
+        topo = new NumaTopology(pinPolicy != -1 ? pinPolicy : pinPolicyFromEnv());
+        numOfNode = (nodeUsed != -1) ? nodeUsed : topo->numOfNode;
+        // nodes may differ in size; every node gets as many workers as the
+        // smallest one can pin
+        coresPerNode = (coresUsed != -1) ? coresUsed : topo->minPinCount(numOfNode);
+        if (coresPerNode < 1)
+            coresPerNode = 1;
+        numOfWorkers = numOfNode * coresPerNode;
+        POLYMER_INFO(LOG_APP, "Polymer - runtime: %d nodes, %d cores per node\n", numOfNode, coresPerNode);
+        topo->print();
+
+        pthread_barrier_init(&leaderBarr, NULL, numOfNode);
+        pthread_barrier_init(&globalBarr, NULL, numOfWorkers);
+        pthread_barrier_init(&startBarr, NULL, numOfWorkers + 1);
+        pthread_barrier_init(&doneBarr, NULL, numOfWorkers + 1);
+        globalSync = new Polymer_barrier(barrierKindFromEnv(), numOfNode, coresPerNode);
+        localBarrs = (pthread_barrier_t *)malloc(sizeof(pthread_barrier_t) * numOfNode);
+        for (int i = 0; i < numOfNode; i++)
+            pthread_barrier_init(&localBarrs[i], NULL, coresPerNode);
+
+        leaderCounter = 0;
+        leaderToggle = 0;
+        localCounters = (volatile int *)calloc(2 * numOfNode, sizeof(int));
+
+        subworkers = (Subworker_Partitioner *)malloc(sizeof(Subworker_Partitioner) * numOfWorkers);
+        workerArgs = (Runtime_worker_arg *)malloc(sizeof(Runtime_worker_arg) * numOfWorkers);
+        threads = (pthread_t *)malloc(sizeof(pthread_t) * numOfWorkers);
+        for (int tid = 0; tid < numOfNode; tid++) {
+            for (int subTid = 0; subTid < coresPerNode; subTid++) {
+                int idx = tid * coresPerNode + subTid;
+                Subworker_Partitioner &subworker = subworkers[idx];
+                subworker = Subworker_Partitioner(coresPerNode);
+                subworker.tid = tid;
+                subworker.subTid = subTid;
+                subworker.dense_start = 0;
+                subworker.dense_end = 0;
+                subworker.global_barr = &globalBarr;
+                subworker.local_barr = &localBarrs[tid];
+                subworker.leader_barr = &leaderBarr;
+                subworker.local_custom = Custom_barrier(&localCounters[2 * tid], &localCounters[2 * tid + 1], coresPerNode);
+                subworker.subMaster_custom = Custom_barrier(&leaderCounter, &leaderToggle, numOfNode);
+                subworker.global_sync = globalSync;
+                workerArgs[idx].rt = this;
+                workerArgs[idx].tid = tid;
+                workerArgs[idx].subTid = subTid;
+            }
+        }
+    }
+
+    void start() {
+        if (started)
+            return;
+        started = true;
+        for (int i = 0; i < numOfWorkers; i++)
+            pthread_create(&threads[i], NULL, polymerRuntimeWorker, (void *)&workerArgs[i]);
+    }
+
+    void dispatch(polymer_kernel fn, void *arg, bool onlySubMasters) {
+        start();
+        kernel = fn;
+        kernelArg = arg;
+        nodesOnly = onlySubMasters;
+        pthread_barrier_wait(&startBarr);
+        pthread_barrier_wait(&doneBarr);
+    }
+
+    inline void run(polymer_kernel fn, void *arg) {
+        dispatch(fn, arg, false);
+    }
+
+    inline void runNodes(polymer_kernel fn, void *arg) {
+        dispatch(fn, arg, true);
+    }
+
+    void stop() {
+        if (!started)
+            return;
+        stopping = true;
+        pthread_barrier_wait(&startBarr);
+        for (int i = 0; i < numOfWorkers; i++)
+            pthread_join(threads[i], NULL);
+        started = false;
+        stopping = false;
+    }
+
+    ~PolymerRuntime() {
+        stop();
+        pthread_barrier_destroy(&leaderBarr);
+        pthread_barrier_destroy(&globalBarr);
+        pthread_barrier_destroy(&startBarr);
+        pthread_barrier_destroy(&doneBarr);
+        for (int i = 0; i < numOfNode; i++)
+            pthread_barrier_destroy(&localBarrs[i]);
+        free(localBarrs);
+        free((void *)localCounters);
+        free(subworkers);
+        free(workerArgs);
+        free(threads);
+        delete globalSync;
+        delete topo;
+    }
+
+    inline Subworker_Partitioner &getSubworker(int tid, int subTid) {
+        return subworkers[tid * coresPerNode + subTid];
+    }
+};
+
+inline void *polymerRuntimeWorker(void *arg) {
+    Runtime_worker_arg *my_arg = (Runtime_worker_arg *)arg;
+    PolymerRuntime *rt = my_arg->rt;
+
+    int node = rt->topo->nodeOf(my_arg->tid);
+    if (node >= 0) { // more nodes than the machine has: run unbound
+        char nodeString[10];
+        sprintf(nodeString, "%d", node);
+        struct bitmask *nodemask = numa_parse_nodestring(nodeString);
+        numa_bind(nodemask);
+        numa_bitmask_free(nodemask);
+    }
+    cpu_set_t nodeSet;
+    cpu_set_t pinSet;
+    sched_getaffinity(0, sizeof(nodeSet), &nodeSet);
+    int cpu = rt->topo->cpuOf(my_arg->tid, my_arg->subTid);
+    if (cpu >= 0) {
+        CPU_ZERO(&pinSet);
+        CPU_SET(cpu, &pinSet);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(pinSet), &pinSet) != 0)
+            cpu = -1;
+    }
+
+    Subworker_Partitioner &subworker = rt->getSubworker(my_arg->tid, my_arg->subTid);
+    while (1) {
+        pthread_barrier_wait(&rt->startBarr);
+        if (rt->stopping)
+            break;
+        if (rt->nodesOnly && subworker.isSubMaster()) {
+            if (cpu >= 0)
+                pthread_setaffinity_np(pthread_self(), sizeof(nodeSet), &nodeSet);
+            rt->kernel(rt->kernelArg, subworker);
+            if (cpu >= 0)
+                pthread_setaffinity_np(pthread_self(), sizeof(pinSet), &pinSet);
+        } else if (!rt->nodesOnly) {
+            rt->kernel(rt->kernelArg, subworker);
+        }
+        pthread_barrier_wait(&rt->doneBarr);
+    }
+    return NULL;
+}
+
+#endif // _POLYMER_RUNTIME_H
@@ -0,0 +1,180 @@
+/*
+ * This code is part of the project "NUMA-aware Graph-structured Analytics"
+ *
+ *
+ * Copyright (C) 2014 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University
+ *     All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * For more about this software, visit:
+ *
+ *     http://ipads.se.sjtu.edu.cn/projects/polymer.html
+ *
+ */
+
+// Gathered sums for the pull kernels of PageRank-like algorithms: every
+// destination adds up a value per in-neighbour, vals[ngh], optionally
+// scaled by the edge weight.  On x86 the sums use AVX-512 or AVX2 gathers,
+// picked at startup from what the CPU supports, with a scalar loop as the
+// fallback.  POLYMER_SIMD=scalar|avx2|avx512 caps the choice.
+//
+// The vector versions add in a different order than the scalar loop, so
+// results can differ in the last bits.
+
+#ifndef _POLYMER_SIMD_H
+#define _POLYMER_SIMD_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "parallel.h"
+
+// target attributes on intrinsics need g++ 5, and the gathers take 32 bit
+// indices
+#if defined(__x86_64__) && defined(__GNUC__) && __GNUC__ >= 5 && !defined(EDGELONG)
+#define POLYMER_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// sum of vals[idx[j]] for j < n
+typedef double (*GatherSumFunc)(const double *vals, const intE *idx, intT n);
+// sum of vals[e[2j]] * e[2j+1] for j < n, e holding (neighbour, weight) pairs
+typedef double (*GatherDotFunc)(const double *vals, const intE *e, intT n);
+
+inline double gatherSumScalar(const double *vals, const intE *idx, intT n) {
+    double sum = 0.0;
+    for (intT j = 0; j < n; j++)
+        sum += vals[idx[j]];
+    return sum;
+}
+
+inline double gatherDotScalar(const double *vals, const intE *e, intT n) {
+    double sum = 0.0;
+    for (intT j = 0; j < n; j++)
+        sum += vals[e[2 * j]] * e[2 * j + 1];
+    return sum;
+}
+
+#ifdef POLYMER_SIMD_X86
+__attribute__((target("avx2")))
+inline double simdHorizontalSum(__m256d v) {
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+__attribute__((target("avx2")))
+inline double gatherSumAVX2(const double *vals, const intE *idx, intT n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    intT j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m128i i0 = _mm_loadu_si128((const __m128i *)(idx + j));
+        __m128i i1 = _mm_loadu_si128((const __m128i *)(idx + j + 4));
+        acc0 = _mm256_add_pd(acc0, _mm256_i32gather_pd(vals, i0, 8));
+        acc1 = _mm256_add_pd(acc1, _mm256_i32gather_pd(vals, i1, 8));
+    }
+    double sum = simdHorizontalSum(_mm256_add_pd(acc0, acc1));
+    for (; j < n; j++)
+        sum += vals[idx[j]];
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+inline double gatherDotAVX2(const double *vals, const intE *e, intT n) {
+    const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256d acc = _mm256_setzero_pd();
+    intT j = 0;
+    for (; j + 4 <= n; j += 4) {
+        __m256i pairs = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(e + 2 * j)), split);
+        __m256d w = _mm256_cvtepi32_pd(_mm256_extracti128_si256(pairs, 1));
+        acc = _mm256_fmadd_pd(_mm256_i32gather_pd(vals, _mm256_castsi256_si128(pairs), 8), w, acc);
+    }
+    double sum = simdHorizontalSum(acc);
+    for (; j < n; j++)
+        sum += vals[e[2 * j]] * e[2 * j + 1];
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+inline double simdHorizontalSum512(__m512d v) {
+    __m256d s = _mm256_add_pd(_mm512_castpd512_pd256(v), _mm512_extractf64x4_pd(v, 1));
+    __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s), _mm256_extractf128_pd(s, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+
+__attribute__((target("avx512f")))
+inline double gatherSumAVX512(const double *vals, const intE *idx, intT n) {
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    intT j = 0;
+    for (; j + 16 <= n; j += 16) {
+        __m256i i0 = _mm256_loadu_si256((const __m256i *)(idx + j));
+        __m256i i1 = _mm256_loadu_si256((const __m256i *)(idx + j + 8));
+        acc0 = _mm512_add_pd(acc0, _mm512_i32gather_pd(i0, vals, 8));
+        acc1 = _mm512_add_pd(acc1, _mm512_i32gather_pd(i1, vals, 8));
+    }
+    double sum = simdHorizontalSum512(_mm512_add_pd(acc0, acc1));
+    for (; j < n; j++)
+        sum += vals[idx[j]];
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+inline double gatherDotAVX512(const double *vals, const intE *e, intT n) {
+    const __m512i split = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    __m512d acc = _mm512_setzero_pd();
+    intT j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m512i pairs = _mm512_permutexvar_epi32(split, _mm512_loadu_si512((const void *)(e + 2 * j)));
+        __m512d w = _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(pairs, 1));
+        acc = _mm512_fmadd_pd(_mm512_i32gather_pd(_mm512_castsi512_si256(pairs), vals, 8), w, acc);
+    }
+    double sum = simdHorizontalSum512(acc);
+    for (; j < n; j++)
+        sum += vals[e[2 * j]] * e[2 * j + 1];
+    return sum;
+}
+#endif
+
+struct SimdKernels {
+    const char *name;
+    GatherSumFunc gatherSum;
+    GatherDotFunc gatherDot;
+};
+
+inline SimdKernels pickSimdKernels() {
+    SimdKernels k = {"scalar", gatherSumScalar, gatherDotScalar};
+#ifdef POLYMER_SIMD_X86
+    const char *env = getenv("POLYMER_SIMD");
+    bool allow512 = env == NULL || strcmp(env, "avx512") == 0;
+    bool allow256 = allow512 || strcmp(env, "avx2") == 0;
+    __builtin_cpu_init();
+    if (allow512 && __builtin_cpu_supports("avx512f")) {
+        k.name = "avx512";
+        k.gatherSum = gatherSumAVX512;
+        k.gatherDot = gatherDotAVX512;
+    } else if (allow256 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        k.name = "avx2";
+        k.gatherSum = gatherSumAVX2;
+        k.gatherDot = gatherDotAVX2;
+    }
+#endif
+    return k;
+}
+
+inline const SimdKernels &simdKernels() {
+    static SimdKernels kernels = pickSimdKernels();
+    return kernels;
+}
+
+#endif // _POLYMER_SIMD_H
@@ -0,0 +1,198 @@
+/*
+ * This code is part of the project "NUMA-aware Graph-structured Analytics"
+ *
+ *
+ * Copyright (C) 2014 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University
+ *     All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * For more about this software, visit:
+ *
+ *     http://ipads.se.sjtu.edu.cn/projects/polymer.html
+ *
+ */
+
+// Work stealing for the dense edgeMap kernels.  Each subworker owns a
+// range of vertex indices of its node's local graph, initially its static
+// share, and takes chunks off the front of it.  Every range sits on its own
+// cache line, so subworkers do not fight over a single counter.
+//
+// An idle subworker first steals half of what is left of a sibling on the
+// same node.  It looks at other nodes only once its whole node has nothing
+// left to steal.  Stolen remote work reads another node's graph, so a
+// remote victim must have enough chunks left to pay for that: at least
+// STEAL_REMOTE_MIN_CHUNKS scaled by the NUMA distance (10 = local).  Nodes
+// are tried nearest first, and a remote steal takes at most that many
+// chunks, which the thief keeps to itself.
+
+#ifndef _POLYMER_STEAL_H
+#define _POLYMER_STEAL_H
+
+#include <numa.h>
+
+#define STEAL_REMOTE_MIN_CHUNKS (4)
+
+typedef unsigned long long stealRange;
+
+// begin in the high half, end in the low half
+inline stealRange packStealRange(intT begin, intT end) {
+    return ((stealRange)(unsigned int)begin << 32) | (unsigned int)end;
+}
+
+inline intT stealRangeBegin(stealRange r) {
+    return (intT)(unsigned int)(r >> 32);
+}
+
+inline intT stealRangeEnd(stealRange r) {
+    return (intT)(unsigned int)r;
+}
+
+struct StealSlot {
+    volatile stealRange range;
+    char pad[BARRIER_LINE - sizeof(stealRange)];
+};
+
+struct StealScheduler {
+    int numOfNodes;
+    int numOfSub;
+    intT chunk;
+    StealSlot *slots;   // node major, numOfNodes * numOfSub
+    void **nodeGraphs;  // vertex array of each node's local graph
+    void **nodeFuncs;   // functor of each node's sub master
+    intT *remoteMin;    // [i * numOfNodes + j]: chunks node j must have left for node i to steal
+    int *remoteOrder;   // [i * numOfNodes + k]: nodes by distance from i, i itself first
+
+    void init(int _numOfNodes) {
+        numOfNodes = _numOfNodes;
+        numOfSub = 0;
+        chunk = 1;
+        slots = NULL;
+        nodeGraphs = (void **)calloc(numOfNodes, sizeof(void *));
+        nodeFuncs = (void **)calloc(numOfNodes, sizeof(void *));
+        remoteMin = (intT *)malloc(sizeof(intT) * numOfNodes * numOfNodes);
+        remoteOrder = (int *)malloc(sizeof(int) * numOfNodes * numOfNodes);
+        bool haveDistance = numa_available() >= 0;
+        for (int i = 0; i < numOfNodes; i++) {
+            for (int j = 0; j < numOfNodes; j++) {
+                int dist = haveDistance ? numa_distance(i, j) : 0;
+                if (dist <= 0) // no distance table
+                    dist = (i == j) ? 10 : 20;
+                remoteMin[i * numOfNodes + j] = STEAL_REMOTE_MIN_CHUNKS * dist / 10;
+            }
+            int *order = remoteOrder + i * numOfNodes;
+            order[0] = i;
+            int len = 1;
+            for (int j = 0; j < numOfNodes; j++) {
+                if (j == i)
+                    continue;
+                int k = len++;
+                while (k > 1 && remoteMin[i * numOfNodes + order[k - 1]] > remoteMin[i * numOfNodes + j]) {
+                    order[k] = order[k - 1];
+                    k--;
+                }
+                order[k] = j;
+            }
+        }
+    }
+
+    // Splits [0, numVertices) of every node's graph statically over its
+    // subworkers.  Called by the master before the barrier that starts the
+    // kernel, and only after every subworker has left the previous one.
+    void reset(int _numOfSub, intT numVertices, intT _chunk) {
+        if (slots == NULL || numOfSub != _numOfSub) {
+            if (slots != NULL)
+                free(slots);
+            numOfSub = _numOfSub;
+            slots = allocBarrierLines<StealSlot>(numOfNodes * numOfSub);
+        }
+        chunk = _chunk;
+        for (int i = 0; i < numOfNodes; i++) {
+            for (int j = 0; j < numOfSub; j++) {
+                intT begin = j * (numVertices / numOfSub);
+                intT end = (j == numOfSub - 1) ? numVertices : ((j + 1) * (numVertices / numOfSub));
+                slots[i * numOfSub + j].range = packStealRange(begin, end);
+            }
+        }
+    }
+
+    // takes the next chunk off the front of a range
+    bool pop(int slot, intT &begin, intT &end) {
+        volatile stealRange *p = &slots[slot].range;
+        while (true) {
+            stealRange r = *p;
+            intT b = stealRangeBegin(r);
+            intT e = stealRangeEnd(r);
+            if (b >= e)
+                return false;
+            intT nb = (e - b > chunk) ? b + chunk : e;
+            if (__sync_bool_compare_and_swap(p, r, packStealRange(nb, e))) {
+                begin = b;
+                end = nb;
+                return true;
+            }
+        }
+    }
+
+    // takes the back half of a range, at most maxChunks chunks, if at least
+    // minChunks chunks are left
+    bool stealFrom(int slot, intT minChunks, intT maxChunks, intT &begin, intT &end) {
+        volatile stealRange *p = &slots[slot].range;
+        while (true) {
+            stealRange r = *p;
+            intT b = stealRangeBegin(r);
+            intT e = stealRangeEnd(r);
+            if (e - b < minChunks * chunk)
+                return false;
+            intT take = (e - b) / 2;
+            if (maxChunks > 0 && take > maxChunks * chunk)
+                take = maxChunks * chunk;
+            if (__sync_bool_compare_and_swap(p, r, packStealRange(b, e - take))) {
+                begin = e - take;
+                end = e;
+                return true;
+            }
+        }
+    }
+
+    // Finds work for subworker subTid of node tid.  Returns the node whose
+    // graph [begin, end) indexes, or -1 when nothing is left to take.
+    int next(int tid, int subTid, intT &begin, intT &end) {
+        int self = tid * numOfSub + subTid;
+        while (true) {
+            if (pop(self, begin, end))
+                return tid;
+            // a sibling's work becomes ours and can be stolen again
+            bool found = false;
+            for (int k = 1; k < numOfSub && !found; k++) {
+                int victim = tid * numOfSub + (subTid + k) % numOfSub;
+                found = stealFrom(victim, 2, 0, begin, end);
+            }
+            if (!found)
+                break;
+            slots[self].range = packStealRange(begin, end);
+        }
+        for (int k = 1; k < numOfNodes; k++) {
+            int node = remoteOrder[tid * numOfNodes + k];
+            intT minChunks = remoteMin[tid * numOfNodes + node];
+            for (int j = 0; j < numOfSub; j++) {
+                int victim = node * numOfSub + (subTid + j) % numOfSub;
+                if (stealFrom(victim, minChunks, minChunks, begin, end))
+                    return node;
+            }
+        }
+        return -1;
+    }
+};
+
+#endif // _POLYMER_STEAL_H
@@ -0,0 +1,246 @@
+/*
+ * This code is part of the project "NUMA-aware Graph-structured Analytics"
+ *
+ *
+ * Copyright (C) 2014 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University
+ *     All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * For more about this software, visit:
+ *
+ *     http://ipads.se.sjtu.edu.cn/projects/polymer.html
+ *
+ */
+
+// Machine topology read from sysfs, used by PolymerRuntime to size and pin
+// its workers.
+//
+// Only online CPUs are considered.  For each one we record its node, its
+// physical core (package + core_id), its position among its SMT siblings
+// and its L3 domain.  Every node then gets an ordered list of CPUs to pin
+// subworkers to, chosen by a policy:
+//   PIN_PHYSICAL_CORE  one CPU per physical core (first SMT sibling)
+//   PIN_HW_THREAD      every hardware thread, siblings next to each other
+//   PIN_NONE           hardware threads as above, but workers are only
+//                      bound to their node, not to a CPU
+// CPUs are ordered by L3 domain, then core, so neighbouring subTids share
+// caches.  When sysfs is unavailable the topology falls back to libnuma
+// with one core per CPU.
+
+#ifndef _POLYMER_TOPOLOGY_H
+#define _POLYMER_TOPOLOGY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <numa.h>
+
+#define PIN_PHYSICAL_CORE (0)
+#define PIN_HW_THREAD (1)
+#define PIN_NONE (2)
+
+struct cpuInfo {
+    int cpu;
+    int node;
+    int core;   // package * 65536 + core_id, unique per physical core
+    int smt;    // index among the core's SMT siblings
+    int llc;    // id of the L3 domain, -1 if unknown
+};
+
+// reads the first line of a sysfs file, false if it does not exist
+inline bool readSysfsLine(const char *path, char *buf, int len) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return false;
+    bool ok = (fgets(buf, len, f) != NULL);
+    fclose(f);
+    return ok;
+}
+
+inline int readSysfsInt(const char *path, int def) {
+    char buf[64];
+    if (!readSysfsLine(path, buf, sizeof(buf)))
+        return def;
+    return atoi(buf);
+}
+
+// parses a cpu list such as "0-3,8,10-11" into mask[0..maxId)
+inline int parseCpuList(const char *str, bool *mask, int maxId) {
+    int count = 0;
+    const char *p = str;
+    while (*p != '\0' && *p != '\n') {
+        char *endp;
+        long lo = strtol(p, &endp, 10);
+        if (endp == p)
+            break;
+        long hi = lo;
+        p = endp;
+        if (*p == '-') {
+            hi = strtol(p + 1, &endp, 10);
+            p = endp;
+        }
+        for (long i = lo; i <= hi; i++) {
+            if (i >= 0 && i < maxId) {
+                mask[i] = true;
+                count++;
+            }
+        }
+        if (*p == ',')
+            p++;
+    }
+    return count;
+}
+
+inline bool cpuInfoCmp(const cpuInfo &a, const cpuInfo &b) {
+    if (a.llc != b.llc)
+        return a.llc < b.llc;
+    if (a.core != b.core)
+        return a.core < b.core;
+    if (a.smt != b.smt)
+        return a.smt < b.smt;
+    return a.cpu < b.cpu;
+}
+
+struct NumaTopology {
+    int numOfNode;     // online nodes that have CPUs
+    int *nodeIds;      // libnuma id of each of them
+    int numOfCpu;      // online CPUs
+    cpuInfo *cpus;
+    int policy;
+    int *pinCount;     // CPUs available to workers on each node
+    int **pinCpus;     // and which ones, in subTid order
+
+    NumaTopology(int _policy = PIN_HW_THREAD) : policy(_policy) {
+        int maxCpu = numa_num_possible_cpus();
+        bool *online = (bool *)calloc(maxCpu, sizeof(bool));
+        char buf[4096];
+        if (!readSysfsLine("/sys/devices/system/cpu/online", buf, sizeof(buf)) ||
+            parseCpuList(buf, online, maxCpu) == 0) {
+            for (int i = 0; i < numa_num_configured_cpus() && i < maxCpu; i++)
+                online[i] = true;
+        }
+
+        cpus = (cpuInfo *)malloc(sizeof(cpuInfo) * maxCpu);
+        numOfCpu = 0;
+        bool *siblings = (bool *)malloc(sizeof(bool) * maxCpu);
+        char path[256];
+        for (int c = 0; c < maxCpu; c++) {
+            if (!online[c])
+                continue;
+            cpuInfo &info = cpus[numOfCpu++];
+            info.cpu = c;
+            info.node = numa_node_of_cpu(c);
+            if (info.node < 0)
+                info.node = 0;
+            sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/core_id", c);
+            int coreId = readSysfsInt(path, c);
+            sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", c);
+            int package = readSysfsInt(path, 0);
+            info.core = package * 65536 + coreId;
+            info.smt = 0;
+            sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", c);
+            if (readSysfsLine(path, buf, sizeof(buf))) {
+                memset(siblings, 0, sizeof(bool) * maxCpu);
+                parseCpuList(buf, siblings, maxCpu);
+                for (int s = 0; s < c; s++)
+                    if (siblings[s] && online[s])
+                        info.smt++;
+            }
+            sprintf(path, "/sys/devices/system/cpu/cpu%d/cache/index3/id", c);
+            info.llc = readSysfsInt(path, -1);
+        }
+        free(siblings);
+        free(online);
+
+        // nodes in id order, skipping memory-only ones
+        int maxNode = numa_max_node() + 1;
+        int *cpusOfNode = (int *)calloc(maxNode, sizeof(int));
+        for (int i = 0; i < numOfCpu; i++)
+            cpusOfNode[cpus[i].node]++;
+        nodeIds = (int *)malloc(sizeof(int) * maxNode);
+        numOfNode = 0;
+        for (int i = 0; i < maxNode; i++)
+            if (cpusOfNode[i] > 0)
+                nodeIds[numOfNode++] = i;
+        free(cpusOfNode);
+
+        std::sort(cpus, cpus + numOfCpu, cpuInfoCmp);
+        pinCount = (int *)calloc(numOfNode, sizeof(int));
+        pinCpus = (int **)malloc(sizeof(int *) * numOfNode);
+        for (int n = 0; n < numOfNode; n++) {
+            pinCpus[n] = (int *)malloc(sizeof(int) * numOfCpu);
+            for (int i = 0; i < numOfCpu; i++) {
+                if (cpus[i].node != nodeIds[n])
+                    continue;
+                if (policy == PIN_PHYSICAL_CORE && cpus[i].smt != 0)
+                    continue;
+                pinCpus[n][pinCount[n]++] = cpus[i].cpu;
+            }
+        }
+    }
+
+    ~NumaTopology() {
+        for (int n = 0; n < numOfNode; n++)
+            free(pinCpus[n]);
+        free(pinCpus);
+        free(pinCount);
+        free(nodeIds);
+        free(cpus);
+    }
+
+    // smallest per-node CPU count, the subworker count every node can host
+    int minPinCount(int nodesUsed) {
+        int res = -1;
+        for (int n = 0; n < nodesUsed && n < numOfNode; n++)
+            if (res == -1 || pinCount[n] < res)
+                res = pinCount[n];
+        return res < 1 ? 1 : res;
+    }
+
+    // libnuma node of runtime node tid, -1 past the machine's nodes
+    inline int nodeOf(int tid) {
+        return (tid < numOfNode) ? nodeIds[tid] : -1;
+    }
+
+    // CPU for subworker subTid of runtime node tid, -1 to leave it unpinned
+    inline int cpuOf(int tid, int subTid) {
+        if (policy == PIN_NONE || tid >= numOfNode || pinCount[tid] == 0)
+            return -1;
+        return pinCpus[tid][subTid % pinCount[tid]];
+    }
+
+    void print() {
+        for (int n = 0; n < numOfNode; n++) {
+            POLYMER_INFO(LOG_APP, "Polymer - node %d: %d workers on cpus", nodeIds[n], pinCount[n]);
+            for (int i = 0; i < pinCount[n]; i++)
+                POLYMER_INFO(LOG_APP, " %d", pinCpus[n][i]);
+            POLYMER_INFO(LOG_APP, "\n");
+        }
+    }
+};
+
+// POLYMER_PIN=core|thread|none, default thread
+inline int pinPolicyFromEnv() {
+    const char *env = getenv("POLYMER_PIN");
+    if (env == NULL)
+        return PIN_HW_THREAD;
+    if (strcmp(env, "core") == 0)
+        return PIN_PHYSICAL_CORE;
+    if (strcmp(env, "none") == 0)
+        return PIN_NONE;
+    return PIN_HW_THREAD;
+}
+
+#endif // _POLYMER_TOPOLOGY_H
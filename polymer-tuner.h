@@ -0,0 +1,190 @@
+/*
+ * This code is part of the project "NUMA-aware Graph-structured Analytics"
+ *
+ *
+ * Copyright (C) 2014 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University
+ *     All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ * For more about this software, visit:
+ *
+ *     http://ipads.se.sjtu.edu.cn/projects/polymer.html
+ *
+ */
+
+// Online choice between the dense and sparse edgeMap kernels.  The caller's
+// threshold on frontier work (vertices plus out-edges) is only the starting
+// point.  Every subworker times its kernel, from the global barrier in
+// front of it to its return, and the slowest one is the sample of the
+// call.  A dense iteration costs about the same whatever the frontier, so
+// its time is a running average; a sparse one is fitted as a fixed cost
+// plus a cost per unit of work, by least squares over decayed samples.
+// Once both fits exist, the threshold is the work at which they meet.
+//
+// Everything is ordered by the barrier in front of each kernel, so the
+// samples and estimates are double buffered by call parity.  Right after
+// the barrier of call k, every subworker has finished kernel k - 1 and
+// taken decision k: the master folds sample k - 1 and publishes the
+// estimate that call k + 2 reads.
+//
+// The decisions depend on measured time, so two runs of the same input can
+// take different kernels.  POLYMER_THRESHOLD overrides the tuning: "caller"
+// keeps the caller's threshold as it is, a number replaces it.
+// POLYMER_THRESHOLD_LOG names a file that receives one line per decision.
+
+#ifndef _POLYMER_TUNER_H
+#define _POLYMER_TUNER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TUNE_AUTO (0)
+#define TUNE_CALLER (1)
+#define TUNE_FIXED (2)
+
+// weight of the newest sample in the running estimates
+#define TUNE_DECAY (0.5)
+
+inline long long tunerNow() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+struct EdgeMapTuner {
+    int mode;
+    long long fixed;
+    volatile long long published[2]; // threshold for calls of each parity, -1 for the caller's
+    double denseTime;   // seconds per dense iteration
+    bool haveDense;
+    double sparseN, sparseW, sparseT, sparseWW, sparseWT; // decayed sums of the sparse samples
+    FILE *log;
+
+    // calls of each parity in flight
+    volatile long long kernelTime[2]; // nanoseconds of the slowest subworker
+    int callNum[2];                   // master only, as are the three below
+    bool callDense[2];
+    long long callWork[2];
+    long long callThreshold[2];
+
+    void init() {
+        mode = TUNE_AUTO;
+        fixed = 0;
+        const char *env = getenv("POLYMER_THRESHOLD");
+        if (env != NULL && strcmp(env, "caller") == 0) {
+            mode = TUNE_CALLER;
+        } else if (env != NULL && env[0] != '\0' && strcmp(env, "auto") != 0) {
+            mode = TUNE_FIXED;
+            fixed = atoll(env);
+        }
+        published[0] = published[1] = -1;
+        denseTime = 0.0;
+        haveDense = false;
+        sparseN = sparseW = sparseT = sparseWW = sparseWT = 0.0;
+        log = NULL;
+        env = getenv("POLYMER_THRESHOLD_LOG");
+        if (env != NULL && env[0] != '\0') {
+            log = fopen(env, "w");
+            if (log == NULL)
+                POLYMER_ERROR(LOG_EDGEMAP, "Polymer - cannot open threshold log %s\n", env);
+            else
+                fprintf(log, "call mode work threshold seconds\n");
+        }
+        kernelTime[0] = kernelTime[1] = 0;
+        callNum[0] = callNum[1] = -1;
+    }
+
+    // folds the kernel time of call slot p into the estimates
+    void record(int p, double seconds) {
+        if (callDense[p]) {
+            denseTime = haveDense ? (1 - TUNE_DECAY) * denseTime + TUNE_DECAY * seconds : seconds;
+            haveDense = true;
+        } else {
+            double w = (double)callWork[p];
+            sparseN = (1 - TUNE_DECAY) * sparseN + 1.0;
+            sparseW = (1 - TUNE_DECAY) * sparseW + w;
+            sparseT = (1 - TUNE_DECAY) * sparseT + seconds;
+            sparseWW = (1 - TUNE_DECAY) * sparseWW + w * w;
+            sparseWT = (1 - TUNE_DECAY) * sparseWT + w * seconds;
+        }
+        if (log != NULL) {
+            fprintf(log, "%d %s %lld %lld %.9f\n", callNum[p], callDense[p] ? "dense" : "sparse",
+                    callWork[p], callThreshold[p], seconds);
+        }
+    }
+
+    // work at which a sparse iteration costs as much as a dense one, -1
+    // while there is no usable fit
+    long long estimate() {
+        double det = sparseN * sparseWW - sparseW * sparseW;
+        if (!haveDense || det <= 0.0)
+            return -1;
+        double perUnit = (sparseN * sparseWT - sparseW * sparseT) / det;
+        double fixedCost = (sparseT - perUnit * sparseW) / sparseN;
+        if (perUnit <= 0.0)
+            return -1;
+        double w = (denseTime - fixedCost) / perUnit;
+        return (w > 0.0) ? (long long)w : 0;
+    }
+
+    // Whether call number call, with the given frontier work, runs dense.
+    // Every subworker calls it with the same arguments.
+    bool decide(int call, bool isMaster, long long work, long long threshold) {
+        long long t = threshold;
+        if (mode == TUNE_FIXED) {
+            t = fixed;
+        } else if (mode == TUNE_AUTO && published[call & 1] >= 0) {
+            t = published[call & 1];
+        }
+        bool dense = (work >= t);
+        if (isMaster) {
+            POLYMER_DEBUG(LOG_EDGEMAP, "Polymer - edgeMap %d: %s, work %lld, threshold %lld\n",
+                          call, dense ? "dense" : "sparse", work, t);
+            callNum[call & 1] = call;
+            callDense[call & 1] = dense;
+            callWork[call & 1] = work;
+            callThreshold[call & 1] = t;
+        }
+        return dense;
+    }
+
+    // Called by every subworker right after the barrier in front of kernel
+    // number call; returns the start of its kernel.
+    long long kernelStart(int call, bool isMaster) {
+        int p = (call - 1) & 1;
+        if (isMaster && call > 0 && callNum[p] == call - 1) {
+            record(p, (double)kernelTime[p] / 1000000000.0);
+            kernelTime[p] = 0;
+            published[call & 1] = estimate();
+        }
+        return tunerNow();
+    }
+
+    // Called by every subworker when its part of kernel number call returns.
+    void kernelEnd(int call, long long start) {
+        long long elapsed = tunerNow() - start;
+        volatile long long *slot = &kernelTime[call & 1];
+        long long old = *slot;
+        while (elapsed > old) {
+            long long seen = __sync_val_compare_and_swap(slot, old, elapsed);
+            if (seen == old)
+                break;
+            old = seen;
+        }
+    }
+};
+
+#endif // _POLYMER_TUNER_H
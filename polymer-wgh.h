@@ -32,6 +32,12 @@
 #include <sys/mman.h>
 
 #include "custom-barrier.h"
+#include "polymer-log.h"
+#include "polymer-tuner.h"
+#include "polymer-functor.h"
+#include "polymer-simd.h"
+#include "polymer-prefetch.h"
+#include "polymer-numa-array.h"
 #include "parallel.h"
 #include "gettime.h"
 #include "utils.h"
@@ -43,8 +49,6 @@
 
 using namespace std;
 
-#define PAGESIZE (4096)
-
 #define MIN(x, y) ((x > y) ? (y) : (x))
 
 //*****START FRAMEWORK*****
@@ -80,10 +84,13 @@ struct Subworker_Partitioner {
     int dense_end;
     pthread_barrier_t *global_barr;
     pthread_barrier_t *local_barr;
+    pthread_barrier_t *leader_barr;
     Custom_barrier local_custom;
     Custom_barrier subMaster_custom;
+    Polymer_barrier *global_sync; // set by PolymerRuntime, NULL otherwise
+    int edgeMapCalls; // numbers the calls for EdgeMapTuner
     
-    Subworker_Partitioner(int nSub):numOfSub(nSub){}
+    Subworker_Partitioner(int nSub):numOfSub(nSub), global_sync(NULL), edgeMapCalls(0){}
     
     inline bool isMaster() {return (tid + subTid == 0);}
     inline bool isSubMaster() {return (subTid == 0);}
@@ -91,9 +98,14 @@ struct Subworker_Partitioner {
     inline intT getEndPos(intT m) {return (subTid == numOfSub - 1) ? m : ((subTid + 1) * (m / numOfSub));}
 
     inline void localWait() {
-	local_custom.wait();
+	if (numOfSub > 1) // a node with one subworker has nothing to wait for
+	    local_custom.wait();
     }
     inline void globalWait() {
+	if (global_sync != NULL) {
+	    global_sync->wait(tid * numOfSub + subTid);
+	    return;
+	}
 	local_custom.wait();
 	if (isSubMaster()) {
 	    subMaster_custom.wait();
@@ -129,51 +141,48 @@ struct Default_Hash_F {
 
 template <class vertex>
 void partitionByDegree(wghGraph<vertex> GA, int numOfShards, int *sizeArr, int sizeOfOneEle, bool useOutDegree=false) {
+    // Shards are whole pages (huge ones when the data arrays use them, see
+    // dataPageSize) of data elements and close on the first block that
+    // brings them to the average degree.  64-bit block sums are prefix-summed
+    // in parallel and each boundary is a binary search.
     const intT n = GA.n;
-    int *degrees = newA(int, n);
-
-    int shardSize = n / numOfShards;
-
-    if (useOutDegree) {
-	{parallel_for(intT i = 0; i < n; i++) degrees[i] = GA.V[i].getOutDegree();}
-    } else {
-	{parallel_for(intT i = 0; i < n; i++) degrees[i] = GA.V[i].getInDegree();}
-    }
-
-    int accum[numOfShards];
-    for (int i = 0; i < numOfShards; i++) {
-	accum[i] = 0;
-	sizeArr[i] = 0;
-    }
-
-    long totalDegree = 0;
-    for (intT i = 0; i < n; i++) {
-	totalDegree += degrees[i];
-    }
-
-    int averageDegree = totalDegree / numOfShards;
-    int counter = 0;
-    int tmpSizeCounter = 0;
-    for (intT i = 0; i < n; i+=PAGESIZE/sizeOfOneEle) {
-	for (intT j = 0; j < PAGESIZE / sizeOfOneEle; j++) {
-	    if (i + j >= n)
-		break;
-	    accum[counter] += degrees[i + j];
-	    sizeArr[counter]++;
-	    tmpSizeCounter++;
+    const intT blockSize = dataPageSize((size_t)n * sizeOfOneEle, numOfShards) / sizeOfOneEle;
+    const intT numOfBlocks = (n + blockSize - 1) / blockSize;
+    long long *blockDegrees = newA(long long, numOfBlocks + 1);
+    {parallel_for (intT b = 0; b < numOfBlocks; b++) {
+	    intT end = min((b + 1) * blockSize, n);
+	    long long sum = 0;
+	    for (intT i = b * blockSize; i < end; i++)
+		sum += useOutDegree ? GA.V[i].getOutDegree() : GA.V[i].getInDegree();
+	    blockDegrees[b] = sum;
 	}
-	if (accum[counter] >= averageDegree && counter < numOfShards - 1) {
-	    counter++;
-	    //cout << tmpSizeCounter / (double)(PAGESIZE / sizeOfOneEle) << endl;
-	    tmpSizeCounter = 0;
+    }
+    long long totalDegree = sequence::plusScan(blockDegrees, blockDegrees, numOfBlocks);
+    blockDegrees[numOfBlocks] = totalDegree;
+    long long averageDegree = totalDegree / numOfShards;
+
+    intT start = 0;
+    for (int k = 0; k < numOfShards; k++) {
+	intT next = numOfBlocks;
+	if (k < numOfShards - 1) {
+	    long long target = blockDegrees[start] + averageDegree;
+	    intT lo = start, hi = numOfBlocks;
+	    while (lo < hi) {
+		intT mid = lo + (hi - lo) / 2;
+		if (blockDegrees[mid + 1] >= target)
+		    hi = mid;
+		else
+		    lo = mid + 1;
+	    }
+	    if (lo < numOfBlocks)
+		next = lo + 1;
 	}
+	sizeArr[k] = min(next * blockSize, n) - min(start * blockSize, n);
+	printf("%d shard: %lld\n", k, blockDegrees[next] - blockDegrees[start]);
+	start = next;
     }
 
-    for (int i = 0; i < numOfShards; i++) {
-	printf("%d shard: %d\n", i, accum[i]);
-    }
-    
-    free(degrees);
+    free(blockDegrees);
 }
 
 template <class vertex>
@@ -296,7 +305,7 @@ void graphInEdgeHasher(wghGraph<vertex> &GA, Hash_F hash) {
 	    //V[i].setFakeDegree(d);
 	    intE *inEdges = V[i].getInNeighborPtr();
 	    for (intT j = 0; j < d; j++) {
-		inEdges[2*j] = hash.hashFunc(inEdges[j]);
+		inEdges[2*j] = hash.hashFunc(inEdges[2*j]);
 	    }
 	    newVertexSet[hash.hashFunc(i)] = V[i];	    
 	}
@@ -317,10 +326,13 @@ void graphAllEdgeHasher(wghGraph<vertex> &GA, Hash_F hash) {
 		outEdges[2*j] = hash.hashFunc(outEdges[2*j]);
 	    }
 	    
-	    d = V[i].getInDegree();	    
+	    // symmetric vertices share one list, it must be remapped once
 	    intE *inEdges = V[i].getInNeighborPtr();
-	    for (intT j = 0; j < d; j++) {
-		inEdges[2*j] = hash.hashFunc(inEdges[j]);
+	    if (inEdges != outEdges) {
+		d = V[i].getInDegree();
+		for (intT j = 0; j < d; j++) {
+		    inEdges[2*j] = hash.hashFunc(inEdges[2*j]);
+		}
 	    }
 	    newVertexSet[hash.hashFunc(i)] = V[i];	    
 	}
@@ -360,7 +372,7 @@ wghGraph<vertex> graphFilter(wghGraph<vertex> &GA, int rangeLow, int rangeHi, bo
     numa_free(counters, sizeof(int) * GA.n);
 
     //intE *edges = (intE *)numa_alloc_local(sizeof(intE) * totalSize * 2);
-    intE *edges = (intE *)malloc((long long)sizeof(intE) * totalSize * (long long)2);
+    intE *edges = (intE *)allocGraphData((long long)sizeof(intE) * totalSize * (long long)2);
 
     {parallel_for (intT i = 0; i < GA.n; i++) {
 	    intE *localEdges = &edges[offsets[i]*2];
@@ -376,10 +388,10 @@ wghGraph<vertex> graphFilter(wghGraph<vertex> &GA, int rangeLow, int rangeHi, bo
 		}
 	    }
 	    if (counter != newVertexSet[i].getFakeDegree()) {
-		printf("oops: %d %d\n", counter, newVertexSet[i].getFakeDegree());
+		POLYMER_ERROR(LOG_PART, "oops: %d %d\n", counter, newVertexSet[i].getFakeDegree());
 	    }
 	    if (i == 0) {
-		printf("fake deg: %d\n", newVertexSet[i].getFakeDegree());
+		POLYMER_DEBUG(LOG_PART, "fake deg: %d\n", newVertexSet[i].getFakeDegree());
 	    }
 	    if (useOutEdge)
 		newVertexSet[i].setOutNeighbors(localEdges);
@@ -439,8 +451,8 @@ wghGraph<vertex> graphFilter2Direction(wghGraph<vertex> &GA, int rangeLow, int r
     numa_free(inCounters, sizeof(int) * GA.n);
 
     //intE *edges = (intE *)numa_alloc_local(sizeof(intE) * totalSize * 2);
-    intE *edges = (intE *)malloc((long long)sizeof(intE) * totalSize * (long long)2);
-    intE *inEdges = (intE *)malloc((long long)sizeof(intE) * totalInSize * (long long)2);
+    intE *edges = (intE *)allocGraphData((long long)sizeof(intE) * totalSize * (long long)2);
+    intE *inEdges = (intE *)allocGraphData((long long)sizeof(intE) * totalInSize * (long long)2);
 
     {parallel_for (intT i = 0; i < GA.n; i++) {
 	    intE *localEdges = &edges[offsets[i]*2];
@@ -456,7 +468,7 @@ wghGraph<vertex> graphFilter2Direction(wghGraph<vertex> &GA, int rangeLow, int r
 		}
 	    }
 	    if (counter != newVertexSet[i].getFakeDegree()) {
-		printf("oops: %d %d\n", counter, newVertexSet[i].getFakeDegree());
+		POLYMER_ERROR(LOG_PART, "oops: %d %d\n", counter, newVertexSet[i].getFakeDegree());
 	    }
 
 	    intE *localInEdges = &inEdges[inOffsets[i]*2];
@@ -473,11 +485,11 @@ wghGraph<vertex> graphFilter2Direction(wghGraph<vertex> &GA, int rangeLow, int r
 	    }
 
 	    if (counter != newVertexSet[i].getFakeInDegree()) {
-		printf("oops: %d %d\n", counter, newVertexSet[i].getFakeInDegree());
+		POLYMER_ERROR(LOG_PART, "oops: %d %d\n", counter, newVertexSet[i].getFakeInDegree());
 	    }
 
 	    if (i == 0) {
-		printf("fake deg: %d\n", newVertexSet[i].getFakeDegree());
+		POLYMER_DEBUG(LOG_PART, "fake deg: %d\n", newVertexSet[i].getFakeDegree());
 	    }
 
 	    newVertexSet[i].setOutNeighbors(localEdges);	    
@@ -489,26 +501,146 @@ wghGraph<vertex> graphFilter2Direction(wghGraph<vertex> &GA, int rangeLow, int r
     return wghGraph<vertex>(newVertexSet, GA.n, GA.m);
 }
 
-void *mapDataArray(int numOfShards, int *sizeArr, int sizeOfOneEle) {
-    int numOfPages = 0;
-    for (int i = 0; i < numOfShards; i++) {	
-        numOfPages += sizeArr[i] / (double)(PAGESIZE / sizeOfOneEle);
+// Owner of vertex v given the running shard boundaries (bounds[i] is the
+// first vertex past node i).
+inline int ownerOfVertex(intT v, intT *bounds, int numOfNodes) {
+    int node = 0;
+    while (node < numOfNodes - 1 && v >= bounds[node])
+	node++;
+    return node;
+}
+
+// Weighted bucketEdgesByNode, see polymer.h: offsets count edges, edges[node]
+// holds (neighbor, weight) pairs.
+template <class vertex>
+void bucketEdgesByNode(wghGraph<vertex> &GA, intT *bounds, int numOfNodes, bool useOutEdge,
+		       long long **offsets, intE **edges) {
+    vertex *V = GA.V;
+    const intT n = GA.n;
+    for (int node = 0; node < numOfNodes; node++)
+	offsets[node] = (long long *)numa_alloc_onnode(sizeof(long long) * (n + 1), node);
+
+    {parallel_for (intT i = 0; i < n; i++) {
+	    for (int node = 0; node < numOfNodes; node++)
+		offsets[node][i] = 0;
+	    intT d = (useOutEdge) ? (V[i].getOutDegree()) : (V[i].getInDegree());
+	    for (intT j = 0; j < d; j++) {
+		intT ngh = (useOutEdge) ? (V[i].getOutNeighbor(j)) : (V[i].getInNeighbor(j));
+		offsets[ownerOfVertex(ngh, bounds, numOfNodes)][i]++;
+	    }
+	}
     }
-    numOfPages++;
 
-    void *toBeReturned = mmap(NULL, numOfPages * PAGESIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (toBeReturned == NULL) {
-	cout << "OOps" << endl;
+    for (int node = 0; node < numOfNodes; node++) {
+	offsets[node][n] = sequence::plusScan(offsets[node], offsets[node], n);
+	edges[node] = (intE *)allocGraphData(sizeof(intE) * 2 * max(offsets[node][n], 1LL), node);
     }
-    
-    int offset = 0;
-    for (int i = 0; i < numOfShards; i++) {
-	void *startPos = (void *)((char *)toBeReturned + offset * sizeOfOneEle);
-	//printf("start binding %d : %d\n", i, offset);
-	numa_tonode_memory(startPos, sizeArr[i], i);
-	offset = offset + sizeArr[i];
+
+    {parallel_for (intT i = 0; i < n; i++) {
+	    long long cursor[numOfNodes];
+	    for (int node = 0; node < numOfNodes; node++)
+		cursor[node] = offsets[node][i];
+	    intT d = (useOutEdge) ? (V[i].getOutDegree()) : (V[i].getInDegree());
+	    for (intT j = 0; j < d; j++) {
+		intT ngh = (useOutEdge) ? (V[i].getOutNeighbor(j)) : (V[i].getInNeighbor(j));
+		intT wgh = (useOutEdge) ? (V[i].getOutWeight(j)) : (V[i].getInWeight(j));
+		int node = ownerOfVertex(ngh, bounds, numOfNodes);
+		edges[node][cursor[node] * 2] = ngh;
+		edges[node][cursor[node] * 2 + 1] = wgh;
+		cursor[node]++;
+	    }
+	}
+    }
+}
+
+// Weighted graphFilter2DirectionAllNodes, see polymer.h.
+template <class vertex>
+wghGraph<vertex> *graphFilter2DirectionAllNodes(wghGraph<vertex> &GA, int *sizeArr, int numOfNodes) {
+    const intT n = GA.n;
+    vertex *V = GA.V;
+    bool hasIn = (sizeof(vertex) == sizeof(asymmetricWghVertex));
+    intT bounds[numOfNodes];
+    intT accum = 0;
+    for (int i = 0; i < numOfNodes; i++) {
+	accum += sizeArr[i];
+	bounds[i] = accum;
+    }
+
+    long long *outOffsets[numOfNodes];
+    intE *outEdges[numOfNodes];
+    long long *inOffsets[numOfNodes];
+    intE *inEdges[numOfNodes];
+    bucketEdgesByNode(GA, bounds, numOfNodes, true, outOffsets, outEdges);
+    if (hasIn) {
+	bucketEdgesByNode(GA, bounds, numOfNodes, false, inOffsets, inEdges);
+    } else {
+	for (int i = 0; i < numOfNodes; i++) {
+	    inOffsets[i] = outOffsets[i];
+	    inEdges[i] = outEdges[i];
+	}
+    }
+
+    wghGraph<vertex> *localGraphs = (wghGraph<vertex> *)malloc(sizeof(wghGraph<vertex>) * numOfNodes);
+    for (int node = 0; node < numOfNodes; node++) {
+	vertex *newVertexSet = (vertex *)numa_alloc_onnode(sizeof(vertex) * n, node);
+	long long *outOff = outOffsets[node];
+	long long *inOff = inOffsets[node];
+	{parallel_for (intT i = 0; i < n; i++) {
+		newVertexSet[i].setOutDegree(V[i].getOutDegree());
+		newVertexSet[i].setInDegree(V[i].getInDegree());
+		newVertexSet[i].setFakeDegree(outOff[i+1] - outOff[i]);
+		newVertexSet[i].setFakeInDegree(inOff[i+1] - inOff[i]);
+		newVertexSet[i].setOutNeighbors(outEdges[node] + outOff[i] * 2);
+		newVertexSet[i].setInNeighbors(inEdges[node] + inOff[i] * 2);
+	    }
+	}
+	localGraphs[node] = wghGraph<vertex>(newVertexSet, n, GA.m);
+    }
+
+    for (int node = 0; node < numOfNodes; node++) {
+	numa_free(outOffsets[node], sizeof(long long) * (n + 1));
+	if (hasIn)
+	    numa_free(inOffsets[node], sizeof(long long) * (n + 1));
+    }
+    return localGraphs;
+}
+
+// Weighted graphFilterAllNodes, see polymer.h.
+template <class vertex>
+wghGraph<vertex> *graphFilterAllNodes(wghGraph<vertex> &GA, int *sizeArr, int numOfNodes, bool useOutEdge=true) {
+    const intT n = GA.n;
+    vertex *V = GA.V;
+    intT bounds[numOfNodes];
+    intT accum = 0;
+    for (int i = 0; i < numOfNodes; i++) {
+	accum += sizeArr[i];
+	bounds[i] = accum;
+    }
+
+    long long *offsets[numOfNodes];
+    intE *edges[numOfNodes];
+    bucketEdgesByNode(GA, bounds, numOfNodes, useOutEdge, offsets, edges);
+
+    wghGraph<vertex> *localGraphs = (wghGraph<vertex> *)malloc(sizeof(wghGraph<vertex>) * numOfNodes);
+    for (int node = 0; node < numOfNodes; node++) {
+	vertex *newVertexSet = (vertex *)numa_alloc_onnode(sizeof(vertex) * n, node);
+	long long *off = offsets[node];
+	{parallel_for (intT i = 0; i < n; i++) {
+		newVertexSet[i].setOutDegree(V[i].getOutDegree());
+		newVertexSet[i].setInDegree(V[i].getInDegree());
+		newVertexSet[i].setFakeDegree(off[i+1] - off[i]);
+		if (useOutEdge)
+		    newVertexSet[i].setOutNeighbors(edges[node] + off[i] * 2);
+		else
+		    newVertexSet[i].setInNeighbors(edges[node] + off[i] * 2);
+	    }
+	}
+	localGraphs[node] = wghGraph<vertex>(newVertexSet, n, GA.m);
     }
-    return toBeReturned;
+
+    for (int node = 0; node < numOfNodes; node++)
+	numa_free(offsets[node], sizeof(long long) * (n + 1));
+    return localGraphs;
 }
 
 struct AsyncChunk {
@@ -533,8 +665,16 @@ struct LocalFrontier {
     intT *chunkSizes;
     intT *tmp;
     bool isDense;
+    intT *subCounts;  // per subworker counts of the node-parallel toSparse
+    int subCountsSize;
+    intT *sBuffer;    // s when it is ours to reuse, with room for sCapacity
+    intT sCapacity;
+    intT **subBuffers; // per subworker output of edgeMapSparseV3
+    intT *subBufferCaps;
+    intT *degPrefix;  // degree prefix of the frontier read by edgeMapSparseV3
+    intT degPrefixCap;
     
-    LocalFrontier(bool *_b, int start, int end):b(_b), startID(start), endID(end), n(end - start), m(0), isDense(true), s(NULL), outEdgesCount(0), sparseChunks(NULL), chunkSizes(NULL){}
+    LocalFrontier(bool *_b, int start, int end):b(_b), startID(start), endID(end), n(end - start), m(0), isDense(true), s(NULL), outEdgesCount(0), sparseChunks(NULL), chunkSizes(NULL), subCounts(NULL), subCountsSize(0), sBuffer(NULL), sCapacity(0), subBuffers(NULL), subBufferCaps(NULL), degPrefix(NULL), degPrefixCap(0){}
     
     bool inRange(int index) { return (startID <= index && index < endID);}
     inline void setBit(int index, bool val) { b[index-startID] = val;}
@@ -544,14 +684,15 @@ struct LocalFrontier {
 	if (isDense) {
 	    if (s != NULL)
 		free(s);
+	    sBuffer = NULL;
 	    _seq<intT> R = sequence::packIndex(b, n);
 	    s = R.A;
 	    m = R.n;
 	    {parallel_for (intT i = 0; i < m; i++) s[i] = s[i] + startID;}
 	    if (m == 0) {
-		printf("%p\n", s);
+		POLYMER_DEBUG(LOG_FRONTIER, "%p\n", s);
 	    } else {
-		printf("M is %d and first ele is %d\n", m, s[0]);
+		POLYMER_DEBUG(LOG_FRONTIER, "M is %d and first ele is %d\n", m, s[0]);
 	    }
 	}
 	isDense = false;
@@ -566,10 +707,142 @@ struct LocalFrontier {
 	isDense = true;
     }
 
+    // makes s an array of at least len entries; the array is kept across
+    // iterations and only replaced when it is too small
+    intT *reserveSparse(intT len) {
+	if (s != NULL && s == sBuffer && sCapacity >= len)
+	    return s;
+	if (s != NULL)
+	    free(s);
+	sCapacity = (len > 0) ? len : 1;
+	s = sBuffer = (intT *)malloc(sizeof(intT) * sCapacity);
+	return s;
+    }
+
+    // scratch for the edge-balanced split of the sparse frontier, sized by
+    // the sub master before a localWait
+    void reservePrefix(intT len) {
+	if (degPrefixCap >= len)
+	    return;
+	if (degPrefix != NULL)
+	    free(degPrefix);
+	degPrefix = (intT *)malloc(sizeof(intT) * len);
+	degPrefixCap = len;
+    }
+
+    // per subworker scratch, sized by the sub master before a localWait
+    void reserveSubArrays(int numOfSub) {
+	if (subCountsSize >= numOfSub)
+	    return;
+	if (subCounts != NULL) {
+	    free(subCounts);
+	    free(subBuffers);
+	    free(subBufferCaps);
+	}
+	subCounts = (intT *)malloc(sizeof(intT) * numOfSub);
+	subBuffers = (intT **)calloc(numOfSub, sizeof(intT *));
+	subBufferCaps = (intT *)calloc(numOfSub, sizeof(intT));
+	subCountsSize = numOfSub;
+    }
+
+    // appends v to the calling subworker's output buffer of length len
+    inline void pushSub(int subTid, intT &len, intT v) {
+	if (len == subBufferCaps[subTid]) {
+	    intT cap = (len < 1024) ? 1024 : len * 2;
+	    subBuffers[subTid] = (intT *)realloc(subBuffers[subTid], sizeof(intT) * cap);
+	    subBufferCaps[subTid] = cap;
+	}
+	subBuffers[subTid][len++] = v;
+    }
+
+    // concatenates the subworker buffers into s in subTid order, called by
+    // every subworker of the node with the length of its own buffer
+    void mergeSubBuffers(Subworker_Partitioner &subworker, intT len) {
+	int subTid = subworker.subTid;
+	intT cap = (s == sBuffer) ? sCapacity : 0;
+	subCounts[subTid] = len;
+	subworker.localWait();
+	intT o = 0;
+	intT total = 0;
+	for (int i = 0; i < subworker.numOfSub; i++) {
+	    if (i == subTid)
+		o = total;
+	    total += subCounts[i];
+	}
+	if (total > cap) { // same decision on every subworker
+	    if (subworker.isSubMaster())
+		reserveSparse(total);
+	    subworker.localWait();
+	}
+	if (len > 0)
+	    memcpy(s + o, subBuffers[subTid], sizeof(intT) * len);
+	if (subworker.isSubMaster())
+	    m = total;
+	subworker.localWait();
+    }
+
+    // Node-parallel conversions: every subworker of the owning node calls
+    // these and handles its own slice.  The caller's next barrier publishes
+    // the result.
+    void toSparse(Subworker_Partitioner &subworker) {
+	if (!isDense)
+	    return;
+	int subTid = subworker.subTid;
+	int numOfSub = subworker.numOfSub;
+	if (subworker.isSubMaster())
+	    reserveSubArrays(numOfSub);
+	subworker.localWait();
+
+	intT startPos = subworker.getStartPos(n);
+	intT endPos = subworker.getEndPos(n);
+	intT count = 0;
+	for (intT i = startPos; i < endPos; i++)
+	    count += b[i];
+	subCounts[subTid] = count;
+	subworker.localWait();
+
+	if (subworker.isSubMaster()) {
+	    intT total = 0;
+	    for (int i = 0; i < numOfSub; i++) {
+		intT c = subCounts[i];
+		subCounts[i] = total;
+		total += c;
+	    }
+	    reserveSparse(total);
+	    m = total;
+	    isDense = false;
+	}
+	subworker.localWait();
+
+	intT o = subCounts[subTid];
+	intT *out = s;
+	for (intT i = startPos; i < endPos; i++) {
+	    if (b[i])
+		out[o++] = i + startID;
+	}
+    }
+
+    void toDense(Subworker_Partitioner &subworker) {
+	if (isDense)
+	    return;
+	intT startPos = subworker.getStartPos(n);
+	intT endPos = subworker.getEndPos(n);
+	for (intT i = startPos; i < endPos; i++)
+	    b[i] = false;
+	subworker.localWait();
+	if (subworker.isSubMaster())
+	    isDense = true;
+	startPos = subworker.getStartPos(m);
+	endPos = subworker.getEndPos(m);
+	for (intT i = startPos; i < endPos; i++)
+	    b[s[i] - startID] = true;
+    }
+
     void setSparse(intT _m, intT *_s) {
 	if (s != NULL) {
 	    free(s);
 	}
+	sBuffer = NULL;
 	m = _m;
 	s = _s;
 	isDense = false;
@@ -582,10 +855,10 @@ struct LocalFrontier {
     }
 
     void clearFrontier() {
-	if (s != NULL) {
+	if (s != NULL && s != sBuffer) {
 	    free(s);
+	    s = NULL;
 	}
-	s = NULL;
 	m = 0;
 	outEdgesCount = 0;
     }
@@ -607,6 +880,7 @@ struct vertices {
     int asyncEndSignal;
     intT readerTail;
     intT insertTail;
+    EdgeMapTuner tuner; // dense/sparse choice of edgeMap
     
     vertices(int _numOfNodes) {
 	this->numOfNodes = _numOfNodes;
@@ -618,6 +892,7 @@ struct vertices {
 	numOfNonZero = (int *)malloc(numOfNodes * sizeof(int));
 	numOfVertices = 0;
 	m = -1;
+	tuner.init();
     }
     /*
     void registerArr(int nodeNum, bool *arr, int size) {
@@ -625,6 +900,20 @@ struct vertices {
 	numOfVertexOnNode[nodeNum] = size;
     }
     */
+    // whether this edgeMap call runs the dense kernel, see polymer-tuner.h
+    bool useDense(Subworker_Partitioner &subworker, long long work, intT threshold) {
+	return tuner.decide(subworker.edgeMapCalls++, subworker.isMaster(), work, threshold);
+    }
+
+    // brackets the kernel of the current edgeMap call for the tuner
+    long long kernelStart(Subworker_Partitioner &subworker) {
+	return tuner.kernelStart(subworker.edgeMapCalls - 1, subworker.isMaster());
+    }
+
+    void kernelEnd(Subworker_Partitioner &subworker, long long start) {
+	tuner.kernelEnd(subworker.edgeMapCalls - 1, start);
+    }
+
     void registerFrontier(int nodeNum, LocalFrontier *frontier) {
 	frontiers[nodeNum] = frontier;
 	numOfVertexOnNode[nodeNum] = frontier->n;
@@ -655,6 +944,19 @@ struct vertices {
 	}
     }
 
+    // each node converts its own frontier with its own subworkers
+    void toDense(Subworker_Partitioner &subworker) {
+	if (subworker.isMaster())
+	    isDense = true;
+	frontiers[subworker.tid]->toDense(subworker);
+    }
+
+    void toSparse(Subworker_Partitioner &subworker) {
+	if (subworker.isMaster())
+	    isDense = false;
+	frontiers[subworker.tid]->toSparse(subworker);
+    }
+
     intT getEdgeStat() {
 	intT sum = 0;
 	for (int i = 0; i < numOfNodes; i++) {
@@ -800,6 +1102,41 @@ struct vertices {
     }
 };
 
+// Walks the sparse arrays of all nodes as one list of numNonzeros()
+// entries, starting at index (which must be below numNonzeros()).
+struct SparseCursor {
+    vertices *frontier;
+    int nodeNum;
+    intT *arr;
+    intT pos;
+    intT left;
+
+    SparseCursor(vertices *_frontier, intT index):frontier(_frontier) {
+	nodeNum = frontier->getNodeNumOfSparseIndex(index);
+	intT offset = 0;
+	for (int i = 0; i < nodeNum; i++) {
+	    offset += frontier->getSparseSize(i);
+	}
+	arr = frontier->getSparseArr(nodeNum);
+	pos = index - offset;
+	left = frontier->getSparseSize(nodeNum) - pos;
+    }
+
+    inline intT next() {
+	while (left <= 0 && nodeNum + 1 < frontier->numOfNodes) {
+	    nodeNum++;
+	    arr = frontier->getSparseArr(nodeNum);
+	    pos = 0;
+	    left = frontier->getSparseSize(nodeNum);
+	}
+	if (left <= 0) {
+	    POLYMER_ERROR(LOG_EDGEMAP, "oops\n");
+	}
+	left--;
+	return arr[pos++];
+    }
+};
+
 struct Default_worker_arg {
     void *GA;
     int maxIter;
@@ -837,6 +1174,8 @@ enum options {
 
 Subworker_Partitioner dummyPartitioner(1);
 
+#include "polymer-runtime.h"
+
 //*****EDGE FUNCTIONS*****
 
 template <class F, class vertex>
@@ -868,17 +1207,19 @@ bool* edgeMapDense(wghGraph<vertex> GA, vertices* frontier, F f, LocalFrontier *
 	currBitVector = frontier->getArr(currNodeNum);
     }
 
+    EdgePrefetcher<vertex, F, true> prefetcher(G, f, startPos, endPos);
     for (intT i = startPos; i < endPos; i++){
 	//next->setBit(i, false);
-	if (f.cond(i)) { 
+	if (functorCond(f, i)) { 
 	    intT d = G[i].getFakeInDegree();
+	    prefetcher.startVertex(i);
 	    for(intT j=0; j<d; j++){
+		prefetcher.edge();
 		intT ngh = G[i].getInNeighbor(j);
-		if (localBitVec[ngh - localOffset] && f.updateAtomic(ngh,i,G[i].getInWeight(j))) {
+		if (localBitVec[ngh - localOffset] && f.updateAtomic(ngh, i, G[i].getInWeight(j)) && FunctorTraits<F>::producesFrontier) {
 		    currBitVector[i - currOffset] = true;
 		}
-		if(!f.cond(i)) break;
-		//__builtin_prefetch(f.nextPrefetchAddr(G[i].getInNeighbor(j+3)), 1, 3);
+		if(!functorCond(f, i)) break;
 	    }
 	}
     }
@@ -911,6 +1252,7 @@ bool* edgeMapDenseForward(wghGraph<vertex> GA, vertices *frontier, F f, LocalFro
 	nextSwitchPoint = frontier->getOffset(currNodeNum+1);
 	currOffset = frontier->getOffset(currNodeNum);
     }
+    EdgePrefetcher<vertex, F, false> prefetcher(G, f, startPos, endPos);
     for (long i=startPos; i<endPos; i++){
 	if (i == nextSwitchPoint) {
 	    currOffset += frontier->getSize(currNodeNum);
@@ -923,9 +1265,11 @@ bool* edgeMapDenseForward(wghGraph<vertex> GA, vertices *frontier, F f, LocalFro
 	m += G[i].getFakeDegree();
 	if (currBitVector[i-currOffset]) {
 	    intT d = G[i].getFakeDegree();
+	    prefetcher.startVertex(i);
 	    for(intT j=0; j<d; j++){
+		prefetcher.edge();
 		uintT ngh = G[i].getOutNeighbor(j);
-		if (/*next->inRange(ngh) &&*/ f.cond(ngh) && f.updateAtomic(i, ngh, G[i].getOutWeight(j))) {
+		if (/*next->inRange(ngh) &&*/ functorCond(f, ngh) && f.updateAtomic(i, ngh, G[i].getOutWeight(j)) && FunctorTraits<F>::producesFrontier) {
 		    /*
 		    if (!next->getBit(ngh)) {
 			m++;
@@ -936,11 +1280,8 @@ bool* edgeMapDenseForward(wghGraph<vertex> GA, vertices *frontier, F f, LocalFro
 		    //m += 1 - SXCHG((char *)&(nextB[idx]), 1);
 		    next->setBit(ngh, true);
 		}
-		//__builtin_prefetch(f.nextPrefetchAddr(G[i].getOutNeighbor(j+1)), 1, 0);
 	    }
 	}
-	//__builtin_prefetch(f.nextPrefetchAddr(i+1), 0, 3);
-	//__builtin_prefetch(G[i+3].getOutNeighborPtr(), 0, 3);
     }
     //writeAdd(&(next->m), m);
     //writeAdd(&(next->outEdgesCount), outEdgesCount);
@@ -948,8 +1289,63 @@ bool* edgeMapDenseForward(wghGraph<vertex> GA, vertices *frontier, F f, LocalFro
     return NULL;
 }
 
+// Dense edgeMap for algorithms that keep every vertex active, see polymer.h.
+// The functor provides
+//
+//   typedef ... Value;
+//   Value sourceValue(intT s);
+//   void updateValue(const Value &val, intT d, intT w);   atomic, w is the edge weight
+template <class F, class vertex>
+void edgeMapAll(wghGraph<vertex> GA, F f, Subworker_Partitioner &subworker) {
+    vertex *G = GA.V;
+    for (intT i = subworker.dense_start; i < subworker.dense_end; i++) {
+	intT d = G[i].getFakeDegree();
+	if (d == 0)
+	    continue;
+	typename F::Value val = f.sourceValue(i);
+	for (intT j = 0; j < d; j++) {
+	    f.updateValue(val, G[i].getOutNeighbor(j), G[i].getOutWeight(j));
+	}
+    }
+}
+
+// Pull flavour of edgeMapAll, see polymer.h; the sum of a destination
+// scales sourceValues()[s] by the weight of the edge from s.
+template <class F, class vertex>
+void edgeMapAllPull(wghGraph<vertex> GA, F f, Subworker_Partitioner &subworker) {
+    vertex *G = GA.V;
+    const double *vals = f.sourceValues();
+    GatherDotFunc gatherDot = simdKernels().gatherDot;
+    for (intT i = subworker.dense_start; i < subworker.dense_end; i++) {
+	intT d = G[i].getFakeInDegree();
+	if (d > 0)
+	    f.addValue(gatherDot(vals, G[i].getInNeighborPtr(), d), i);
+    }
+}
+
+// Reducer concept of edgeMapDenseReduce.  The functor declares
+//
+//   typedef ... Accum;                             per destination state
+//   void initFunc(Accum &acc, intT d);             identity for d
+//   bool reduceFunc(Accum &acc, intT s, intT w);   folds in source s over an edge of weight w
+//   bool combineFunc(const Accum &acc, intT d);    finalizes into d
+template <class F>
+struct ReducerCheck {
+    typedef typename F::Accum Accum;
+
+    static void check() {
+	void (F::*init)(Accum &, intT) = &F::initFunc;
+	bool (F::*reduce)(Accum &, intT, intT) = &F::reduceFunc;
+	bool (F::*combine)(const Accum &, intT) = &F::combineFunc;
+	(void)init;
+	(void)reduce;
+	(void)combine;
+    }
+};
+
 template <class F, class vertex>
 bool* edgeMapDenseReduce(wghGraph<vertex> GA, vertices* frontier, F f, LocalFrontier *next, bool parallel = 0, Subworker_Partitioner &subworker = dummyPartitioner) {
+    ReducerCheck<F>::check();
     intT numVertices = GA.n;
     intT size = next->endID - next->startID;
     vertex *G = GA.V;
@@ -988,21 +1384,23 @@ bool* edgeMapDenseReduce(wghGraph<vertex> GA, vertices* frontier, F f, LocalFron
 	    currBitVector = frontier->getNextArr(currNodeNum);
 	}
 	if (true || f.cond(i)) { 
-	    double data[2];
+	    typename F::Accum acc;
 	    intT d = G[i].getFakeInDegree();
-	    f.initFunc((void *)data);
+	    f.initFunc(acc, i);
 	    bool shouldActive = false;
 	    for(intT j=0; j<d; j++){
 		intT ngh = G[i].getInNeighbor(j);
-		if (/*localBitVec[ngh - localOffset] && */f.reduceFunc((void *)data, ngh, G[i].getInWeight(j))) {
-		    currBitVector[i - currOffset] = true;
-		    //shouldActive = true;
+		if (/*localBitVec[ngh - localOffset] && */f.reduceFunc(acc, ngh, G[i].getInWeight(j))) {
+		    shouldActive = true;
 		}
 		//if(!f.cond(i)) break;
 		//__builtin_prefetch(f.nextPrefetchAddr(G[i].getInNeighbor(j+3)), 1, 3);
 	    }
+	    if (shouldActive && FunctorTraits<F>::producesFrontier) {
+		currBitVector[i - currOffset] = true;
+	    }
 	    if (d > 0) {
-		f.combineFunc((void *)data, i);
+		f.combineFunc(acc, i);
 	    }
 	}
     }
@@ -1016,7 +1414,7 @@ bool* edgeMapDenseForwardDynamic(wghGraph<vertex> GA, vertices *frontier, F f, L
     intT numVertices = GA.n;
     vertex *G = GA.V;
     if (subworker.isMaster()) {
-	printf("we are here\n");
+	POLYMER_TRACE(LOG_EDGEMAP, "we are here\n");
     }
     int currNodeNum = 0;
     bool *currBitVector = frontier->getArr(currNodeNum);
@@ -1053,7 +1451,7 @@ bool* edgeMapDenseForwardDynamic(wghGraph<vertex> GA, vertices *frontier, F f, L
 		intT d = G[i].getFakeDegree();
 		for(intT j=0; j<d; j++){
 		    uintT ngh = G[i].getOutNeighbor(j);
-		    if (f.cond(ngh) && f.updateAtomic(i, ngh, G[i].getOutWeight(j))) {
+		    if (functorCond(f, ngh) && f.updateAtomic(i, ngh, G[i].getOutWeight(j)) && FunctorTraits<F>::producesFrontier) {
 			next->setBit(ngh, true);
 		    }
 		}
@@ -1096,7 +1494,7 @@ bool* edgeMapDenseForwardGlobalWrite(wghGraph<vertex> GA, vertices *frontier, F
 	    nextBitVector = nexts[currNodeNum]->b;
 	}
 	m += G[i].getFakeDegree();
-	if (f.cond(i)) {
+	if (functorCond(f, i)) {
 	    intT d = G[i].getFakeDegree();
 	    for(intT j=0; j<d; j++) {
 		uintT ngh = G[i].getInNeighbor(j);
@@ -1139,7 +1537,7 @@ void edgeMapSparseAsync(wghGraph<vertex> GA, vertices *frontier, F f, LocalFront
     *endSignal = 0;
     pthread_barrier_wait(subworker.local_barr);
     if (subworker.isSubMaster()) {
-	printf("passed barrier\n");
+	POLYMER_TRACE(LOG_EDGEMAP, "passed barrier\n");
     }
     int accumSize = 0;
     AsyncChunk *myChunk = newChunk(BLOCK_SIZE);
@@ -1152,7 +1550,7 @@ void edgeMapSparseAsync(wghGraph<vertex> GA, vertices *frontier, F f, LocalFront
 	AsyncChunk *currChunk = NULL;
 	/*
 	if (*endSignal == 1) {
-	    printf("spin: %d %d %d %d %d\n", subworker.tid, subworker.subTid, currHead, currTail, endPos);
+	    POLYMER_TRACE(LOG_EDGEMAP, "spin: %d %d %d %d %d\n", subworker.tid, subworker.subTid, currHead, currTail, endPos);
 	}
 	*/
 	do {
@@ -1173,7 +1571,7 @@ void edgeMapSparseAsync(wghGraph<vertex> GA, vertices *frontier, F f, LocalFront
 	    //process chunk
 	    currChunk = frontier->asyncQueue[currHead % GA.n];
 	    if (currChunk == NULL) {
-		printf("oops: %p %p %d %d %d\n", currChunk, frontier->asyncQueue[currHead % GA.n], currHead, currTail, endPos);
+		POLYMER_ERROR(LOG_EDGEMAP, "oops: %p %p %d %d %d\n", currChunk, frontier->asyncQueue[currHead % GA.n], currHead, currTail, endPos);
 	    }
 	    //printf("chunk pointer: %p\n", currChunk);
 	    int chunkSize = currChunk->m;
@@ -1183,7 +1581,7 @@ void edgeMapSparseAsync(wghGraph<vertex> GA, vertices *frontier, F f, LocalFront
 		intT d = V[idx].getOutDegree();
 		for (intT j = 0; j < d; j++) {
 		    intT ngh = V[idx].getOutNeighbor(j);
-		    if (f.cond(ngh) && f.updateAtomic(idx, ngh, V[idx].getOutWeight(j))) {
+		    if (functorCond(f, ngh) && f.updateAtomic(idx, ngh, V[idx].getOutWeight(j))) {
 			//add ngh into chunk
 			myChunk->s[myChunk->m] = ngh;
 			myChunk->m += 1;
@@ -1192,14 +1590,14 @@ void edgeMapSparseAsync(wghGraph<vertex> GA, vertices *frontier, F f, LocalFront
 			    intT insertPos = __sync_fetch_and_add(insertTail, 1);
 			    /*
 			    if (*endSignal == 1)
-				printf("before insert %d %d %d\n", *queueTail, insertPos, *insertTail);
+				POLYMER_TRACE(LOG_EDGEMAP, "before insert %d %d %d\n", *queueTail, insertPos, *insertTail);
 			    */
 			    frontier->asyncQueue[insertPos % GA.n] = myChunk;
 			    //__asm__ __volatile__ ("mfence\n":::);
 			    while (!__sync_bool_compare_and_swap((intT *)queueTail, insertPos, insertPos+1)) {				
 				if (*queueTail > insertPos) {
 				    break;
-				    printf("pending on insert %d %d %d\n", *queueTail, insertPos, *insertTail);
+				    POLYMER_TRACE(LOG_EDGEMAP, "pending on insert %d %d %d\n", *queueTail, insertPos, *insertTail);
 				}
 				
 			    }
@@ -1228,7 +1626,7 @@ void edgeMapSparseAsync(wghGraph<vertex> GA, vertices *frontier, F f, LocalFront
 		while (!__sync_bool_compare_and_swap((intT *)queueTail, insertPos, insertPos+1)) {
 		    if (*queueTail > insertPos) {
 			break;
-			printf("pending on insert %d %d %d\n", *queueTail, insertPos, *insertTail);
+			POLYMER_TRACE(LOG_EDGEMAP, "pending on insert %d %d %d\n", *queueTail, insertPos, *insertTail);
 		    }
 		}
 		//printf("insert over: %d %d\n", insertPos, *queueTail);
@@ -1259,7 +1657,7 @@ void edgeMapSparseAsync(wghGraph<vertex> GA, vertices *frontier, F f, LocalFront
 		    *(signals[i]) = 1;
 		    if (marker > frontier->numOfNodes) {
 			*endSignal = 1;
-			printf("master out\n");
+			POLYMER_TRACE(LOG_EDGEMAP, "master out\n");
 			shouldFinish = true;
 			break;
 		    }
@@ -1271,69 +1669,162 @@ void edgeMapSparseAsync(wghGraph<vertex> GA, vertices *frontier, F f, LocalFront
     //printf("end loop of %d %d: %d\n", subworker.tid, subworker.subTid, accumSize);
 }
 
+// Interleaved traversal of the sparse frontier, see polymer.h; the
+// adjacency lists hold (neighbour, weight) pairs.
+template <class F, class vertex>
+inline void edgeMapSparseInterleaved(vertex *V, F &f, vertices *frontier, LocalFrontier *next, int subTid,
+				     intT vBegin, intT jBegin, intT eBegin, intT eEnd, intT currM, intT &nextM, intT &nextEdgesCount,
+				     intT &edgesVisited) {
+    const PrefetchConfig &config = prefetchConfig();
+    int group = config.sparseGroup;
+    intT ids[SPARSE_GROUP_MAX];
+    intT from[SPARSE_GROUP_MAX];
+    intT to[SPARSE_GROUP_MAX];
+
+    SparseCursor cursor(frontier, vBegin);
+    intT e = eBegin - jBegin; // position of the first edge of the next vertex
+    bool done = false;
+    for (intT i = vBegin; i < currM && !done; i += group) {
+	// frontier ids, prefetch the vertex records
+	int n = 0;
+	for (; n < group && i + n < currM; n++) {
+	    ids[n] = cursor.next();
+	    __builtin_prefetch(&V[ids[n]], 0, 3);
+	}
+	// edge ranges, prefetch the adjacency lists
+	int m = 0;
+	for (; m < n; m++) {
+	    if (eEnd >= 0 && e >= eEnd) {
+		done = true;
+		break;
+	    }
+	    intT d = V[ids[m]].getFakeDegree();
+	    from[m] = (i + m == vBegin) ? jBegin : 0;
+	    to[m] = (eEnd >= 0 && eEnd - e < d) ? eEnd - e : d;
+	    e += d;
+	    if (from[m] < to[m]) {
+		edgesVisited += to[m] - from[m];
+		__builtin_prefetch(V[ids[m]].getOutNeighborPtr() + 2 * from[m], 0, 3);
+	    }
+	}
+	// prefetch the state of the first neighbours
+	for (int k = 0; k < m; k++) {
+	    intT ahead = (to[k] - from[k] < config.distance) ? to[k] : from[k] + config.distance;
+	    for (intT j = from[k]; j < ahead; j++) {
+		intT ngh = V[ids[k]].getOutNeighbor(j);
+		__builtin_prefetch(f.nextPrefetchAddr(ngh), 1, 3);
+	    }
+	}
+	// the updates, prefetching further down long adjacency lists
+	for (int k = 0; k < m; k++) {
+	    intT idx = ids[k];
+	    for (intT j = from[k]; j < to[k]; j++) {
+		if (j + config.distance < to[k])
+		    __builtin_prefetch(f.nextPrefetchAddr(V[idx].getOutNeighbor(j + config.distance)), 1, 3);
+		uintT ngh = V[idx].getOutNeighbor(j);
+		if (functorCond(f, ngh) && f.updateAtomic(idx, ngh, V[idx].getOutWeight(j)) && FunctorTraits<F>::producesFrontier) {
+		    next->pushSub(subTid, nextM, ngh);
+		    nextEdgesCount += V[ngh].getOutDegree();
+		}
+	    }
+	}
+    }
+}
+
 template <class F, class vertex>
 void edgeMapSparseV3(wghGraph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, bool part = false, Subworker_Partitioner &subworker = dummyPartitioner) {
     vertex *V = GA.V;
     if (part) {
 	intT currM = frontier->numNonzeros();
-	int startPos = subworker.getStartPos(currM);
-	int endPos = subworker.getEndPos(currM);
+	int subTid = subworker.subTid;
+	int numOfSub = subworker.numOfSub;
 
-	intT *mPtr = &(next->m);
-	*mPtr = 0;
+	// every subworker appends to its own node-local buffer, kept across
+	// iterations; mergeSubBuffers concatenates them into next->s
 	next->outEdgesCount = 0;
-	int bufferLen = frontier->getEdgeStat();
-	if (subworker.isSubMaster())
-	    next->s = (intT *)malloc(sizeof(intT) * bufferLen);
+	if (subworker.isSubMaster()) {
+	    next->reserveSubArrays(numOfSub);
+	    next->reserveSparse(frontier->getEdgeStat());
+	    next->reservePrefix(currM + 1);
+	}
 	intT nextEdgesCount = 0;
-	
+	intT nextM = 0;
+
 	//pthread_barrier_wait(subworker.local_barr);
 	subworker.localWait();
-	intT *nextFrontier = next->s;
-	
-	if (startPos < endPos) {
-	    //printf("have ele: %d to %d %d, %p\n", startPos, endPos, subworker.tid, next);	    
-	    int currNodeNum = frontier->getNodeNumOfSparseIndex(startPos);
-	    int offset = 0;
-	    for (int i = 0; i < currNodeNum; i++) {
-		offset += frontier->getSparseSize(i);
-	    }
-	    intT *currActiveList = frontier->getSparseArr(currNodeNum);
-	    int lengthOfCurr = frontier->getSparseSize(currNodeNum) - (startPos - offset);
-	    //printf("nodeNum of %d %d: %d from %d to %d\n", subworker.tid, subworker.subTid, currNodeNum, startPos, endPos);
-	    for (int i = startPos; i < endPos; i++) {
-		if (lengthOfCurr <= 0) {
-		    while (currNodeNum + 1 < frontier->numOfNodes && lengthOfCurr <= 0) {
-			offset += frontier->getSparseSize(currNodeNum);
-			currNodeNum++;
-			lengthOfCurr = frontier->getSparseSize(currNodeNum);
-			//printf("lengthOfCurr: %d\n", lengthOfCurr);
-		    }
-		    if (currNodeNum >= frontier->numOfNodes || lengthOfCurr <= 0) {
-			printf("oops\n");
-		    }
-		    currActiveList = frontier->getSparseArr(currNodeNum);
-		}
-		intT idx = currActiveList[i - offset];
-		intT d = V[idx].getFakeDegree();
-		for (intT j = 0; j < d; j++) {
-		    uintT ngh = V[idx].getOutNeighbor(j);
-		    //printf("from %d to %d len %d\n", idx, ngh, V[idx].getOutWeight(j));
-		    if (f.cond(ngh) && f.updateAtomic(idx, ngh, V[idx].getOutWeight(j))) {
-			int tmp = __sync_fetch_and_add(mPtr, 1);
-			if (tmp >= bufferLen)
-			    printf("oops\n");
-			nextFrontier[tmp] = ngh;
-			nextEdgesCount += V[ngh].getOutDegree();
-		    }
+
+	// Split the frontier by edges rather than by vertices, so that the
+	// adjacency of a hub is shared by the subworkers of the node.  The
+	// degree prefix is built in parallel over vertex slices, then every
+	// subworker takes an equal range of edges and finds its first vertex
+	// by binary search (merge-path).
+	intT vBegin = 0;
+	intT jBegin = 0;
+	intT eBegin = 0;
+	intT eEnd = 0;
+	if (numOfSub > 1) {
+	    intT *degPrefix = next->degPrefix;
+	    intT startPos = subworker.getStartPos(currM);
+	    intT endPos = subworker.getEndPos(currM);
+	    intT sum = 0;
+	    if (startPos < endPos) {
+		SparseCursor cursor(frontier, startPos);
+		for (intT i = startPos; i < endPos; i++) {
+		    sum += V[cursor.next()].getFakeDegree();
+		    degPrefix[i + 1] = sum;
 		}
-		lengthOfCurr--;
-		//printf("nextM: %d %d\n", nextM, nextEdgesCount);
 	    }
+	    next->subCounts[subTid] = sum;
+	    subworker.localWait();
+	    intT base = 0;
+	    for (int i = 0; i < subTid; i++) {
+		base += next->subCounts[i];
+	    }
+	    for (intT i = startPos; i < endPos; i++) {
+		degPrefix[i + 1] += base;
+	    }
+	    if (subworker.isSubMaster())
+		degPrefix[0] = 0;
+	    subworker.localWait();
+
+	    intT totalEdges = degPrefix[currM];
+	    intT chunk = totalEdges / numOfSub;
+	    eBegin = subTid * chunk;
+	    eEnd = (subTid == numOfSub - 1) ? totalEdges : eBegin + chunk;
+	    if (eBegin < eEnd) {
+		vBegin = (intT)(std::upper_bound(degPrefix, degPrefix + currM + 1, eBegin) - degPrefix) - 1;
+		jBegin = eBegin - degPrefix[vBegin];
+	    } else {
+		vBegin = currM;
+	    }
+	} else {
+	    eEnd = -1; // a single subworker takes every edge
+	}
+
+	intT edgesVisited = 0;
+	if (vBegin < currM) {
+	    edgeMapSparseInterleaved(V, f, frontier, next, subTid, vBegin, jBegin, eBegin, eEnd, currM, nextM, nextEdgesCount, edgesVisited);
+	}
+#if POLYMER_LOG_LEVEL >= POLYMER_LOG_DEBUG
+	// the edge ranges of the subworkers must tile the frontier's edges
+	if (numOfSub > 1) {
+	    if (edgesVisited != ((eBegin < eEnd) ? eEnd - eBegin : 0))
+		POLYMER_ERROR(LOG_EDGEMAP, "oops: subworker %d of node %d visited %d edges of [%d, %d)\n", subTid, subworker.tid, edgesVisited, eBegin, eEnd);
+	    next->subCounts[subTid] = edgesVisited;
+	    subworker.localWait();
+	    if (subworker.isSubMaster()) {
+		intT visited = 0;
+		for (int i = 0; i < numOfSub; i++)
+		    visited += next->subCounts[i];
+		if (visited != next->degPrefix[currM])
+		    POLYMER_ERROR(LOG_EDGEMAP, "oops: sparse edgeMap of node %d visited %d of %d edges\n", subworker.tid, visited, next->degPrefix[currM]);
+	    }
+	    subworker.localWait();
 	}
+#endif
 	__sync_fetch_and_add(&(next->outEdgesCount), nextEdgesCount);
 	//pthread_barrier_wait(subworker.local_barr);
-	subworker.localWait();
+	next->mergeSubBuffers(subworker, nextM);
     }
 }
 
@@ -1370,16 +1861,15 @@ void edgeMap(wghGraph<vertex> GA, vertices *V, F f, LocalFrontier *next, intT th
     */
     int start = subworker.dense_start;
     int end = subworker.dense_end;
+    bool dense = V->useDense(subworker, m, threshold);
 
     if (subworker.isMaster()) {
-	printf(((m >= threshold) ? "Dense\n" : "Sparse\n"));
+	POLYMER_DEBUG(LOG_EDGEMAP, dense ? "Dense\n" : "Sparse\n");
     }
 
-    if (m >= threshold) {
+    if (dense) {
 	//Dense part
-	if (subworker.isMaster()) {
-	    V->toDense();	    
-	}
+	V->toDense(subworker);
 
 	if (subworker.isSubMaster()) {
 	    next->sparseCounter = 0;
@@ -1387,21 +1877,23 @@ void edgeMap(wghGraph<vertex> GA, vertices *V, F f, LocalFrontier *next, intT th
 	clearLocalFrontier(next, subworker.tid, subworker.subTid, subworker.numOfSub);
 	//pthread_barrier_wait(subworker.global_barr);
 	subworker.globalWait();
+	long long kernelStart = V->kernelStart(subworker);
 	
 	bool* R = (option == DENSE_FORWARD) ? 
 	    edgeMapDenseForward(GA, V, f, next, part, start, end) :
 	    //edgeMapDenseForwardDynamic(GA, V, f, next, subworker) :
 	    edgeMapDense(GA, V, f, next, option, subworker);
+	V->kernelEnd(subworker, kernelStart);
 	next->isDense = true;
     } else {
 	//Sparse part
-	if (subworker.isMaster()) {
-	    V->toSparse();
-	}
+	V->toSparse(subworker);
 
 	//pthread_barrier_wait(subworker.global_barr);
 	subworker.globalWait();
+	long long kernelStart = V->kernelStart(subworker);
 	edgeMapSparseV3(GA, V, f, next, part, subworker);
+	V->kernelEnd(subworker, kernelStart);
 	next->isDense = false;
     }
 }
@@ -1510,6 +2002,22 @@ void vertexMap(LocalFrontier *V, F add, int nodeNum, int subNum, int totalSub) {
     }
 }
 
+// vertexMap over every vertex of the node, whatever its frontier holds
+template <class F>
+void vertexMapAll(vertices *V, F add, int nodeNum, int subNum, int totalSub) {
+    int size = V->getSize(nodeNum);
+    int offset = V->getOffset(nodeNum);
+    int subSize = size / totalSub;
+    int startPos = subSize * subNum;
+    int endPos = subSize * (subNum + 1);
+    if (subNum == totalSub - 1) {
+	endPos = size;
+    }
+    for (int i = startPos; i < endPos; i++) {
+	add(i + offset);
+    }
+}
+
 void clearLocalFrontier(LocalFrontier *next, int nodeNum, int subNum, int totalSub) {
     int size = next->endID - next->startID;
     //int offset = V->getOffset(nodeNum);
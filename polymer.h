@@ -32,19 +32,25 @@
 #include <sys/mman.h>
 
 #include "custom-barrier.h"
+#include "polymer-log.h"
 #include "parallel.h"
 #include "gettime.h"
 #include "utils.h"
 #include "graph.h"
 #include "IO-numa.h"
+#include "polymer-bitmap.h"
+#include "polymer-steal.h"
+#include "polymer-tuner.h"
+#include "polymer-functor.h"
+#include "polymer-simd.h"
+#include "polymer-prefetch.h"
+#include "polymer-numa-array.h"
 
 #include <numa.h>
 #include <pthread.h>
 
 using namespace std;
 
-#define PAGESIZE (4096)
-
 #define MIN(x, y) ((x > y) ? (y) : (x))
 
 //*****START FRAMEWORK*****
@@ -54,7 +60,7 @@ the vertices set should be set by each node
 */
 
 inline int SXCHG(char *ptr, char newv) {
-    printf("Polymer - SXCHG\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - SXCHG\n");
 
     char ret = newv;
     __asm__ __volatile__ (
@@ -66,7 +72,7 @@ inline int SXCHG(char *ptr, char newv) {
 }
 
 int roundUp(double x) {
-    printf("Polymer - roundUp\n");
+    POLYMER_TRACE(LOG_FRONTIER, "Polymer - roundUp\n");
 
     int ones = x / 1;
     double others = x - ones;
@@ -87,9 +93,11 @@ struct Subworker_Partitioner {
     pthread_barrier_t *leader_barr;
     Custom_barrier local_custom;
     Custom_barrier subMaster_custom;
+    Polymer_barrier *global_sync; // set by PolymerRuntime, NULL otherwise
+    int edgeMapCalls; // numbers the calls for EdgeMapTuner
 
-    Subworker_Partitioner(int nSub):numOfSub(nSub) {
-        printf("Polymer - struct Subworker_Partitioner\n");
+    Subworker_Partitioner(int nSub):numOfSub(nSub), global_sync(NULL), edgeMapCalls(0) {
+        POLYMER_TRACE(LOG_EDGEMAP, "Polymer - struct Subworker_Partitioner\n");
     }
 
     inline bool isMaster() {
@@ -106,9 +114,14 @@ struct Subworker_Partitioner {
     }
 
     inline void localWait() {
-        local_custom.wait();
+        if (numOfSub > 1) // a node with one subworker has nothing to wait for
+            local_custom.wait();
     }
     inline void globalWait() {
+        if (global_sync != NULL) {
+            global_sync->wait(tid * numOfSub + subTid);
+            return;
+        }
         local_custom.wait();
         if (isSubMaster()) {
             subMaster_custom.wait();
@@ -122,7 +135,7 @@ struct Default_Hash_F {
     int vertPerShard;
     int n;
     Default_Hash_F(int _n, int _shardNum):n(_n), shardNum(_shardNum), vertPerShard(_n / _shardNum) {
-        printf("Polymer - struct Default_Hash_F\n");
+        POLYMER_TRACE(LOG_PART, "Polymer - struct Default_Hash_F\n");
     }
 
     inline int hashFunc(int index) {
@@ -146,106 +159,66 @@ struct Default_Hash_F {
 
 template <class vertex>
 void partitionByDegree(graph<vertex> GA, int numOfShards, int *sizeArr, int sizeOfOneEle, bool useOutDegree=false) {
-    printf("Polymer - partitionByDegree\n");
-
+    POLYMER_TRACE(LOG_PART, "Polymer - partitionByDegree\n");
+
+    // Shards are whole pages of data elements, huge pages when the data
+    // arrays will use them (dataPageSize).  A shard closes on the first
+    // block that brings it to the average degree; that block stays if it
+    // lands closer to the average than leaving it out, otherwise it opens
+    // the next shard.  Block degree sums are 64-bit and prefix-summed in
+    // parallel, so each boundary is a binary search.
     const intT n = GA.n;
-    int *degrees = newA(int, n);
-
-    int shardSize = n / numOfShards;
-    printf("Polymer - partitionByDegree - Vertices/NUMA Node = %d\n", shardSize);
-
-    if (useOutDegree) {
-        {
-            printf("Polymer - partitionByDegree - Work using Out degree");            
-            parallel_for(intT i = 0; i < n; i++) degrees[i] = GA.V[i].getOutDegree();
-        }
-    } else {
-        {
-            printf("Polymer - partitionByDegree - Work using In degree");
-            parallel_for(intT i = 0; i < n; i++) degrees[i] = GA.V[i].getInDegree();
+    const intT blockSize = dataPageSize((size_t)n * sizeOfOneEle, numOfShards) / sizeOfOneEle;
+    const intT numOfBlocks = (n + blockSize - 1) / blockSize;
+    long long *blockDegrees = newA(long long, numOfBlocks + 1);
+    {   parallel_for (intT b = 0; b < numOfBlocks; b++) {
+            intT end = min((b + 1) * blockSize, n);
+            long long sum = 0;
+            if (useOutDegree) {
+                for (intT i = b * blockSize; i < end; i++) sum += GA.V[i].getOutDegree();
+            } else {
+                for (intT i = b * blockSize; i < end; i++) sum += GA.V[i].getInDegree();
+            }
+            blockDegrees[b] = sum;
         }
     }
+    long long totalDegree = sequence::plusScan(blockDegrees, blockDegrees, numOfBlocks);
+    blockDegrees[numOfBlocks] = totalDegree;
+    long long averageDegree = totalDegree / numOfShards;
 
-    int accum[numOfShards];
-    for (int i = 0; i < numOfShards; i++) {
-        accum[i] = 0;
-        sizeArr[i] = 0;
-    }
-
-    long totalDegree = 0;
-    for (intT i = 0; i < n; i++) {
-        totalDegree += degrees[i];
-    }
-
-    int averageDegree = totalDegree / numOfShards;
-    printf("Polymer - partitionByDegree - Average Degree = %d\n", averageDegree);
-    int counter = 0;
-    int tmpSizeCounter = 0;
-    printf("Polymer - partitionByDegree - Counter(Before Loop) = %d\n", counter);
-    printf("Polymer - partitionByDegree - Increment (in vertex) = %d\n", PAGESIZE/sizeOfOneEle);
-    for (intT i = 0; i < n; i+=PAGESIZE/sizeOfOneEle) {
-        printf("Polymer - partitionByDegree - Index i = %d\n", i);
-
-        int localAccum = 0;
-        int localSize = 0;
-        for (intT j = 0; j < PAGESIZE / sizeOfOneEle; j++) {
-            printf("Polymer - partitionByDegree - Index j = %d\n", j);
-
-            printf("Polymer - partitionByDegree - i + j = %d\n", i + j);
-            if (i + j >= n) 
-            {
-                printf("Polymer - partitionByDegree - i + j > n, then break!");
-                break;
+    intT start = 0;
+    bool carried = false; // first block of this shard was handed over by the previous one
+    for (int k = 0; k < numOfShards; k++) {
+        intT next = numOfBlocks;
+        if (k < numOfShards - 1) {
+            // smallest b >= lo with blockDegrees[b+1] - blockDegrees[start] >= averageDegree
+            long long target = blockDegrees[start] + averageDegree;
+            intT lo = carried ? start + 1 : start;
+            intT hi = numOfBlocks;
+            while (lo < hi) {
+                intT mid = lo + (hi - lo) / 2;
+                if (blockDegrees[mid + 1] >= target)
+                    hi = mid;
+                else
+                    lo = mid + 1;
             }
-            //accum[counter] += degrees[i + j];
-            //sizeArr[counter]++;
-            localAccum += degrees[i + j];
-            localSize++;
-            tmpSizeCounter++;
-
-            printf("Polymer - partitionByDegree - For i + j = %d - Local Accum = %d\n", i + j, localAccum);
-            printf("Polymer - partitionByDegree - For i + j = %d - Local Size = %d\n", i + j, localSize);
-            printf("Polymer - partitionByDegree - For i + j = %d - Temporary Size Counter = %d\n", i + j, tmpSizeCounter);
-        }
-        accum[counter] += localAccum;
-        sizeArr[counter] += localSize;
-
-        printf("Polymer - partitionByDegree - Counter(After j Loop) = %d\n", counter);
-        printf("Polymer - partitionByDegree - For i = %d - Accum = %d\n", i, accum[counter]);
-        printf("Polymer - partitionByDegree - For i = %d - Size = %d\n", i, sizeArr[counter]);
-        printf("Polymer - partitionByDegree - For i = %d - Temporary Size Counter = %d\n", i, tmpSizeCounter);
-
-        if (accum[counter] >= averageDegree && counter < numOfShards - 1) {
-            printf("Polymer - partitionByDegree - Accum > Average Degree && Counter < NUMA Node Count\n");
-
-            int oldDiff = averageDegree - (accum[counter] - localAccum);
-            int newDiff = accum[counter] - averageDegree;
-            if (oldDiff < newDiff) {
-                accum[counter] -= localAccum;
-                sizeArr[counter] -= localSize;
-            } else {
-                localAccum = 0;
-                localSize = 0;
+            if (lo < numOfBlocks) {
+                long long oldDiff = target - blockDegrees[lo];
+                long long newDiff = blockDegrees[lo + 1] - target;
+                carried = (oldDiff < newDiff);
+                next = carried ? lo : lo + 1;
             }
-            counter++;
-            accum[counter] += localAccum;
-            sizeArr[counter] += localSize;
-            //cout << tmpSizeCounter / (double)(PAGESIZE / sizeOfOneEle) << endl;
-            tmpSizeCounter = 0;
-
-            printf("Polymer - partitionByDegree - Counter(After Check & Increment) = %d\n", counter);
-            printf("Polymer - partitionByDegree - For i = %d - Accum = %d\n", i, accum[counter]);
-            printf("Polymer - partitionByDegree - For i = %d - Size = %d\n", i, sizeArr[counter]);
-            printf("Polymer - partitionByDegree - For i = %d - Temporary Size Counter = %d\n", i, tmpSizeCounter);
         }
+        sizeArr[k] = min(next * blockSize, n) - min(start * blockSize, n);
+        start = next;
     }
 
-    free(degrees);
+    free(blockDegrees);
 }
 
 template <class vertex>
 void subPartitionByDegree(graph<vertex> GA, int numOfShards, int *sizeArr, int sizeOfOneEle, bool useOutDegree=false, bool useFakeDegree=false) {
-    printf("Polymer - subPartitionByDegree - Def#1\n");
+    POLYMER_TRACE(LOG_PART, "Polymer - subPartitionByDegree - Def#1\n");
 
     const intT n = GA.n;
     int *degrees = newA(int, n);
@@ -298,7 +271,7 @@ void subPartitionByDegree(graph<vertex> GA, int numOfShards, int *sizeArr, int s
 
 template <class vertex>
 void subPartitionByDegree(graph<vertex> GA, int numOfShards, int *sizeArr, int sizeOfOneEle, int subStart, int subEnd, bool useOutDegree=false, bool useFakeDegree=false) {
-    printf("Polymer - subPartitionByDegree - Def#2\n");
+    POLYMER_TRACE(LOG_PART, "Polymer - subPartitionByDegree - Def#2\n");
 
     const intT n = subEnd - subStart;
     int *degrees = newA(int, n);
@@ -351,7 +324,7 @@ void subPartitionByDegree(graph<vertex> GA, int numOfShards, int *sizeArr, int s
 
 template <class vertex, class Hash_F>
 void graphHasher(graph<vertex> &GA, Hash_F hash) {
-    printf("Polymer - graphHasher\n");
+    POLYMER_TRACE(LOG_PART, "Polymer - graphHasher\n");
 
     vertex *V = GA.V;
     vertex *newVertexSet = (vertex *)malloc(sizeof(vertex) * GA.n);
@@ -372,7 +345,7 @@ void graphHasher(graph<vertex> &GA, Hash_F hash) {
 
 template <class vertex, class Hash_F>
 void graphInEdgeHasher(graph<vertex> &GA, Hash_F hash) {
-    printf("Polymer - graphInEdgeHasher\n");
+    POLYMER_TRACE(LOG_PART, "Polymer - graphInEdgeHasher\n");
 
     vertex *V = GA.V;
     vertex *newVertexSet = (vertex *)malloc(sizeof(vertex) * GA.n);
@@ -393,36 +366,27 @@ void graphInEdgeHasher(graph<vertex> &GA, Hash_F hash) {
 
 template <class vertex, class Hash_F>
 void graphAllEdgeHasher(graph<vertex> &GA, Hash_F hash) {
-    printf("Polymer - graphAllEdgeHasher\n");
+    POLYMER_TRACE(LOG_PART, "Polymer - graphAllEdgeHasher\n");
 
     vertex *V = GA.V;
     vertex *newVertexSet = (vertex *)malloc(sizeof(vertex) * GA.n);
 
     {   parallel_for (intT i = 0; i < GA.n; i++) {
-            printf("Polymer - graphAllEdgeHasher - Vertex# = %d\n", i);
-
             intT d = V[i].getOutDegree();
-            printf("Polymer - graphAllEdgeHasher - Vertex# = %d - Degree Out = %d\n", i, d);
-
             V[i].setFakeDegree(d);
             intE *outEdges = V[i].getOutNeighborPtr();
             for (intT j = 0; j < d; j++) {
-                printf("Polymer - graphAllEdgeHasher - Vertex# = %d - Degree Out = %d - Edge#%d(Before Hash Fn) = %d\n", i, d, j, outEdges[j]);
                 outEdges[j] = hash.hashFunc(outEdges[j]);
-                printf("Polymer - graphAllEdgeHasher - Vertex# = %d - Degree Out = %d - Edge#%d(After Hash Fn) = %d\n", i, d, j, outEdges[j]);
             }
-            d = V[i].getInDegree();
+            // symmetric vertices share one list, it must be remapped once
             intE *inEdges = V[i].getInNeighborPtr();
-            printf("Polymer - graphAllEdgeHasher - Vertex# = %d - Degree In = %d\n", i, d);
-            for (intT j = 0; j < d; j++) {
-                printf("Polymer - graphAllEdgeHasher - Vertex# = %d - Degree In = %d - Edge#%d(Before Hash Fn) = %d\n", i, d, j, inEdges[j]);
-                inEdges[j] = hash.hashFunc(inEdges[j]);
-                printf("Polymer - graphAllEdgeHasher - Vertex# = %d - Degree In = %d - Edge#%d(After Hash Fn) = %d\n", i, d, j, inEdges[j]);
+            if (inEdges != outEdges) {
+                d = V[i].getInDegree();
+                for (intT j = 0; j < d; j++) {
+                    inEdges[j] = hash.hashFunc(inEdges[j]);
+                }
             }
-            printf("Polymer - graphAllEdgeHasher - Vertex#(Before Hash Fn) = %d\n", i);
-            intT i_after_hash = hash.hashFunc(i);
-            newVertexSet[i_after_hash] = V[i];
-            printf("Polymer - graphAllEdgeHasher - Vertex#(After Hash Fn) = %d\n", i_after_hash);
+            newVertexSet[hash.hashFunc(i)] = V[i];
         }
     }
     GA.V = newVertexSet;
@@ -431,7 +395,7 @@ void graphAllEdgeHasher(graph<vertex> &GA, Hash_F hash) {
 
 template <class vertex>
 graph<vertex> graphFilter(graph<vertex> &GA, int rangeLow, int rangeHi, bool useOutEdge=true) {
-    printf("Polymer - graphFilter\n");
+    POLYMER_TRACE(LOG_PART, "Polymer - graphFilter\n");
 
     vertex *V = GA.V;
     vertex *newVertexSet = (vertex *)numa_alloc_local(sizeof(vertex) * GA.n);
@@ -461,7 +425,7 @@ graph<vertex> graphFilter(graph<vertex> &GA, int rangeLow, int rangeHi, bool use
 
     numa_free(counters, sizeof(int) * GA.n);
 
-    intE *edges = (intE *)numa_alloc_local(sizeof(intE) * totalSize);
+    intE *edges = (intE *)allocGraphData(sizeof(intE) * totalSize);
 
     {   parallel_for (intT i = 0; i < GA.n; i++) {
             intE *localEdges = &edges[offsets[i]];
@@ -475,10 +439,10 @@ graph<vertex> graphFilter(graph<vertex> &GA, int rangeLow, int rangeHi, bool use
                 }
             }
             if (counter != newVertexSet[i].getFakeDegree()) {
-                printf("oops: %d %d\n", counter, newVertexSet[i].getFakeDegree());
+                POLYMER_ERROR(LOG_PART, "oops: %d %d\n", counter, newVertexSet[i].getFakeDegree());
             }
             if (i == 0) {
-                printf("fake deg: %d\n", newVertexSet[i].getFakeDegree());
+                POLYMER_DEBUG(LOG_PART, "fake deg: %d\n", newVertexSet[i].getFakeDegree());
             }
             if (useOutEdge)
                 newVertexSet[i].setOutNeighbors(localEdges);
@@ -493,7 +457,7 @@ graph<vertex> graphFilter(graph<vertex> &GA, int rangeLow, int rangeHi, bool use
 
 template <class vertex>
 graph<vertex> graphFilter2Direction(graph<vertex> &GA, int rangeLow, int rangeHi) {
-    printf("Polymer - graphFilter2Direction\n");
+    POLYMER_TRACE(LOG_PART, "Polymer - graphFilter2Direction\n");
 
     vertex *V = GA.V;
     vertex *newVertexSet = (vertex *)numa_alloc_local(sizeof(vertex) * GA.n);
@@ -539,9 +503,9 @@ graph<vertex> graphFilter2Direction(graph<vertex> &GA, int rangeLow, int rangeHi
     numa_free(counters, sizeof(int) * GA.n);
     numa_free(inCounters, sizeof(int) * GA.n);
 
-    intE *edges = (intE *)numa_alloc_local(sizeof(intE) * totalSize);
-    intE *inEdges = (intE *)numa_alloc_local(sizeof(intE) * totalInSize);
-    printf("totalInSize is %d\n", totalInSize);
+    intE *edges = (intE *)allocGraphData(sizeof(intE) * totalSize);
+    intE *inEdges = (intE *)allocGraphData(sizeof(intE) * totalInSize);
+    POLYMER_DEBUG(LOG_PART, "totalInSize is %d\n", totalInSize);
 
     {   parallel_for (intT i = 0; i < GA.n; i++) {
             intE *localEdges = &edges[offsets[i]];
@@ -555,7 +519,7 @@ graph<vertex> graphFilter2Direction(graph<vertex> &GA, int rangeLow, int rangeHi
                 }
             }
             if (counter != newVertexSet[i].getFakeDegree()) {
-                printf("oops: %d %d\n", counter, newVertexSet[i].getFakeDegree());
+                POLYMER_ERROR(LOG_PART, "oops: %d %d\n", counter, newVertexSet[i].getFakeDegree());
             }
 
             intE *localInEdges = &inEdges[inOffsets[i]];
@@ -569,11 +533,11 @@ graph<vertex> graphFilter2Direction(graph<vertex> &GA, int rangeLow, int rangeHi
                 }
             }
             if (counter != newVertexSet[i].getFakeInDegree()) {
-                printf("oops: %d %d\n", counter, newVertexSet[i].getFakeInDegree());
+                POLYMER_ERROR(LOG_PART, "oops: %d %d\n", counter, newVertexSet[i].getFakeInDegree());
             }
 
             if (i == 0) {
-                printf("fake deg: %d\n", newVertexSet[i].getFakeDegree());
+                POLYMER_DEBUG(LOG_PART, "fake deg: %d\n", newVertexSet[i].getFakeDegree());
             }
 
             newVertexSet[i].setOutNeighbors(localEdges);
@@ -586,36 +550,148 @@ graph<vertex> graphFilter2Direction(graph<vertex> &GA, int rangeLow, int rangeHi
     return graph<vertex>(newVertexSet, GA.n, GA.m);
 }
 
-void *mapDataArray(int numOfShards, int *sizeArr, int sizeOfOneEle) {
-    printf("Polymer - mapDataArray\n");
+// Owner of vertex v given the running shard boundaries (bounds[i] is the
+// first vertex past node i).
+inline int ownerOfVertex(intT v, intT *bounds, int numOfNodes) {
+    int node = 0;
+    while (node < numOfNodes - 1 && v >= bounds[node])
+        node++;
+    return node;
+}
 
-    int numOfPages = 0;
-    for (int i = 0; i < numOfShards; i++) {
-        numOfPages += sizeArr[i] / (double)(PAGESIZE / sizeOfOneEle);
-        printf("Polymer - mapDataArray - Number of Pages on NUMA Node #%d = %d\n", sizeArr[i] / (double)(PAGESIZE / sizeOfOneEle));
+// Buckets the out (or in) edges of every vertex by the node owning the
+// neighbor.  One pass counts, one pass copies; each node's edges are
+// allocated on that node.  offsets[node] gets n + 1 entries.
+template <class vertex>
+void bucketEdgesByNode(graph<vertex> &GA, intT *bounds, int numOfNodes, bool useOutEdge,
+                       long long **offsets, intE **edges) {
+    vertex *V = GA.V;
+    const intT n = GA.n;
+    for (int node = 0; node < numOfNodes; node++)
+        offsets[node] = (long long *)numa_alloc_onnode(sizeof(long long) * (n + 1), node);
+
+    {   parallel_for (intT i = 0; i < n; i++) {
+            for (int node = 0; node < numOfNodes; node++)
+                offsets[node][i] = 0;
+            intT d = (useOutEdge) ? (V[i].getOutDegree()) : (V[i].getInDegree());
+            for (intT j = 0; j < d; j++) {
+                intT ngh = (useOutEdge) ? (V[i].getOutNeighbor(j)) : (V[i].getInNeighbor(j));
+                offsets[ownerOfVertex(ngh, bounds, numOfNodes)][i]++;
+            }
+        }
     }
-    numOfPages++;
-    printf("Polymer - mapDataArray - Number of Pages = %d\n", numOfPages);
 
-    void *toBeReturned = mmap(NULL, numOfPages * PAGESIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (toBeReturned == NULL) {
-        cout << "OOps" << endl;
+    for (int node = 0; node < numOfNodes; node++) {
+        offsets[node][n] = sequence::plusScan(offsets[node], offsets[node], n);
+        edges[node] = (intE *)allocGraphData(sizeof(intE) * max(offsets[node][n], 1LL), node);
     }
 
-    printf("Polymer - mapDataArray - Map data to NUMA Nodes\n");    
-    int offset = 0;
-    printf("Polymer - mapDataArray - Offset = %d\n", offset);
-    for (int i = 0; i < numOfShards; i++) {
-        printf("Polymer - mapDataArray - NUMA Node # = %d\n", i);
-        void *startPos = (void *)((char *)toBeReturned + offset * sizeOfOneEle);
-        printf("Polymer - mapDataArray - Start Position = %d\n", startPos);
-        printf("Polymer - mapDataArray - Size Array = %d\n", sizeArr[i]);
-        //printf("start binding %d : %d\n", i, offset);
-        numa_tonode_memory(startPos, sizeArr[i], i);
-        offset = offset + sizeArr[i];
-        printf("Polymer - mapDataArray - Offset = %d\n", offset);
-    }
-    return toBeReturned;
+    {   parallel_for (intT i = 0; i < n; i++) {
+            long long cursor[numOfNodes];
+            for (int node = 0; node < numOfNodes; node++)
+                cursor[node] = offsets[node][i];
+            intT d = (useOutEdge) ? (V[i].getOutDegree()) : (V[i].getInDegree());
+            for (intT j = 0; j < d; j++) {
+                intT ngh = (useOutEdge) ? (V[i].getOutNeighbor(j)) : (V[i].getInNeighbor(j));
+                int node = ownerOfVertex(ngh, bounds, numOfNodes);
+                edges[node][cursor[node]++] = ngh;
+            }
+        }
+    }
+}
+
+// Builds the local graph of every node in one pass over the global graph,
+// equivalent to calling graphFilter2Direction(GA, rangeLow, rangeHi) on
+// each node but with O(m) total work instead of O(numOfNodes * m).  Vertex
+// arrays and edges of localGraphs[i] live on node i.
+template <class vertex>
+graph<vertex> *graphFilter2DirectionAllNodes(graph<vertex> &GA, int *sizeArr, int numOfNodes) {
+    const intT n = GA.n;
+    vertex *V = GA.V;
+    bool hasIn = (sizeof(vertex) == sizeof(asymmetricVertex));
+    intT bounds[numOfNodes];
+    intT accum = 0;
+    for (int i = 0; i < numOfNodes; i++) {
+        accum += sizeArr[i];
+        bounds[i] = accum;
+    }
+
+    long long *outOffsets[numOfNodes];
+    intE *outEdges[numOfNodes];
+    long long *inOffsets[numOfNodes];
+    intE *inEdges[numOfNodes];
+    bucketEdgesByNode(GA, bounds, numOfNodes, true, outOffsets, outEdges);
+    if (hasIn) {
+        bucketEdgesByNode(GA, bounds, numOfNodes, false, inOffsets, inEdges);
+    } else {
+        for (int i = 0; i < numOfNodes; i++) {
+            inOffsets[i] = outOffsets[i];
+            inEdges[i] = outEdges[i];
+        }
+    }
+
+    graph<vertex> *localGraphs = (graph<vertex> *)malloc(sizeof(graph<vertex>) * numOfNodes);
+    for (int node = 0; node < numOfNodes; node++) {
+        vertex *newVertexSet = (vertex *)numa_alloc_onnode(sizeof(vertex) * n, node);
+        long long *outOff = outOffsets[node];
+        long long *inOff = inOffsets[node];
+        {   parallel_for (intT i = 0; i < n; i++) {
+                newVertexSet[i].setOutDegree(V[i].getOutDegree());
+                newVertexSet[i].setInDegree(V[i].getInDegree());
+                newVertexSet[i].setFakeDegree(outOff[i+1] - outOff[i]);
+                newVertexSet[i].setFakeInDegree(inOff[i+1] - inOff[i]);
+                newVertexSet[i].setOutNeighbors(outEdges[node] + outOff[i]);
+                newVertexSet[i].setInNeighbors(inEdges[node] + inOff[i]);
+            }
+        }
+        localGraphs[node] = graph<vertex>(newVertexSet, n, GA.m);
+    }
+
+    for (int node = 0; node < numOfNodes; node++) {
+        numa_free(outOffsets[node], sizeof(long long) * (n + 1));
+        if (hasIn)
+            numa_free(inOffsets[node], sizeof(long long) * (n + 1));
+    }
+    return localGraphs;
+}
+
+// One direction only: equivalent to calling graphFilter(GA, rangeLow,
+// rangeHi, useOutEdge) on each node.
+template <class vertex>
+graph<vertex> *graphFilterAllNodes(graph<vertex> &GA, int *sizeArr, int numOfNodes, bool useOutEdge=true) {
+    const intT n = GA.n;
+    vertex *V = GA.V;
+    intT bounds[numOfNodes];
+    intT accum = 0;
+    for (int i = 0; i < numOfNodes; i++) {
+        accum += sizeArr[i];
+        bounds[i] = accum;
+    }
+
+    long long *offsets[numOfNodes];
+    intE *edges[numOfNodes];
+    bucketEdgesByNode(GA, bounds, numOfNodes, useOutEdge, offsets, edges);
+
+    graph<vertex> *localGraphs = (graph<vertex> *)malloc(sizeof(graph<vertex>) * numOfNodes);
+    for (int node = 0; node < numOfNodes; node++) {
+        vertex *newVertexSet = (vertex *)numa_alloc_onnode(sizeof(vertex) * n, node);
+        long long *off = offsets[node];
+        {   parallel_for (intT i = 0; i < n; i++) {
+                newVertexSet[i].setOutDegree(V[i].getOutDegree());
+                newVertexSet[i].setInDegree(V[i].getInDegree());
+                newVertexSet[i].setFakeDegree(off[i+1] - off[i]);
+                if (useOutEdge)
+                    newVertexSet[i].setOutNeighbors(edges[node] + off[i]);
+                else
+                    newVertexSet[i].setInNeighbors(edges[node] + off[i]);
+            }
+        }
+        localGraphs[node] = graph<vertex>(newVertexSet, n, GA.m);
+    }
+
+    for (int node = 0; node < numOfNodes; node++)
+        numa_free(offsets[node], sizeof(long long) * (n + 1));
+    return localGraphs;
 }
 
 struct AsyncChunk {
@@ -642,25 +718,59 @@ struct LocalFrontier {
     intT *tmp;
     AsyncChunk **localQueue;
     bool isDense;
+    intT *subCounts;  // per subworker counts of the node-parallel toSparse
+    int subCountsSize;
+    bitWord *bits;    // dense frontier as a bitmap, b is NULL then
+    intT *sBuffer;    // s when it is ours to reuse, with room for sCapacity
+    intT sCapacity;
+    intT **subBuffers; // per subworker output of edgeMapSparseV3
+    intT *subBufferCaps;
+    intT *degPrefix;  // degree prefix of the frontier read by edgeMapSparseV3
+    intT degPrefixCap;
 
-    LocalFrontier(bool *_b, int start, int end):b(_b), startID(start), endID(end), n(end - start), m(0), isDense(true), s(NULL), outEdgesCount(0), sparseChunks(NULL), chunkSizes(NULL) {
-        printf("Polymer - struct LocalFrontier\n");
+    LocalFrontier(bool *_b, int start, int end):b(_b), startID(start), endID(end), n(end - start), m(0), isDense(true), s(NULL), outEdgesCount(0), sparseChunks(NULL), chunkSizes(NULL), subCounts(NULL), subCountsSize(0), bits(NULL), sBuffer(NULL), sCapacity(0), subBuffers(NULL), subBufferCaps(NULL), degPrefix(NULL), degPrefixCap(0) {
+        POLYMER_TRACE(LOG_FRONTIER, "Polymer - struct LocalFrontier\n");
+    }
+
+    LocalFrontier(bitWord *_bits, int start, int end):b(NULL), startID(start), endID(end), n(end - start), m(0), isDense(true), s(NULL), outEdgesCount(0), sparseChunks(NULL), chunkSizes(NULL), subCounts(NULL), subCountsSize(0), bits(_bits), sBuffer(NULL), sCapacity(0), subBuffers(NULL), subBufferCaps(NULL), degPrefix(NULL), degPrefixCap(0) {
+        POLYMER_TRACE(LOG_FRONTIER, "Polymer - struct LocalFrontier (bitmap)\n");
     }
 
     bool inRange(int index) {
         return (startID <= index && index < endID);
     }
+    inline bool isBitmap() {
+        return bits != NULL;
+    }
+    inline FrontierBits view() {
+        return FrontierBits(b, bits);
+    }
     inline void setBit(int index, bool val) {
+        if (bits != NULL) {
+            if (val)
+                bitmapSetAtomic(bits, index - startID);
+            else
+                bitmapClearAtomic(bits, index - startID);
+            return;
+        }
         b[index-startID] = val;
     }
     inline bool getBit(int index) {
+        if (bits != NULL)
+            return bitmapGet(bits, index - startID);
         return b[index-startID];
     }
 
     void toSparse() {
-        if (isDense) {
+        if (isDense && bits != NULL) {
+            intT words = bitmapWords(n);
+            m = bitmapCountWords(bits, 0, words);
+            reserveSparse(m);
+            bitmapPackWords(bits, 0, words, s, startID);
+        } else if (isDense) {
             if (s != NULL)
                 free(s);
+            sBuffer = NULL;
             _seq<intT> R = sequence::packIndex(b, n);
             s = R.A;
             m = R.n;
@@ -668,18 +778,174 @@ struct LocalFrontier {
                 parallel_for (intT i = 0; i < m; i++) s[i] = s[i] + startID;
             }
             if (m == 0) {
-                printf("%p\n", s);
+                POLYMER_DEBUG(LOG_FRONTIER, "%p\n", s);
             } else {
-                printf("M is %d and first ele is %d\n", m, s[0]);
+                POLYMER_DEBUG(LOG_FRONTIER, "M is %d and first ele is %d\n", m, s[0]);
             }
         }
         isDense = false;
     }
 
+    // makes s an array of at least len entries; the array is kept across
+    // iterations and only replaced when it is too small
+    intT *reserveSparse(intT len) {
+        if (s != NULL && s == sBuffer && sCapacity >= len)
+            return s;
+        if (s != NULL)
+            free(s);
+        sCapacity = (len > 0) ? len : 1;
+        s = sBuffer = (intT *)malloc(sizeof(intT) * sCapacity);
+        return s;
+    }
+
+    // scratch for the edge-balanced split of the sparse frontier, sized by
+    // the sub master before a localWait
+    void reservePrefix(intT len) {
+        if (degPrefixCap >= len)
+            return;
+        if (degPrefix != NULL)
+            free(degPrefix);
+        degPrefix = (intT *)malloc(sizeof(intT) * len);
+        degPrefixCap = len;
+    }
+
+    // per subworker scratch, sized by the sub master before a localWait
+    void reserveSubArrays(int numOfSub) {
+        if (subCountsSize >= numOfSub)
+            return;
+        if (subCounts != NULL) {
+            free(subCounts);
+            free(subBuffers);
+            free(subBufferCaps);
+        }
+        subCounts = (intT *)malloc(sizeof(intT) * numOfSub);
+        subBuffers = (intT **)calloc(numOfSub, sizeof(intT *));
+        subBufferCaps = (intT *)calloc(numOfSub, sizeof(intT));
+        subCountsSize = numOfSub;
+    }
+
+    // appends v to the calling subworker's output buffer of length len
+    inline void pushSub(int subTid, intT &len, intT v) {
+        if (len == subBufferCaps[subTid]) {
+            intT cap = (len < 1024) ? 1024 : len * 2;
+            subBuffers[subTid] = (intT *)realloc(subBuffers[subTid], sizeof(intT) * cap);
+            subBufferCaps[subTid] = cap;
+        }
+        subBuffers[subTid][len++] = v;
+    }
+
+    // concatenates the subworker buffers into s in subTid order, called by
+    // every subworker of the node with the length of its own buffer
+    void mergeSubBuffers(Subworker_Partitioner &subworker, intT len) {
+        int subTid = subworker.subTid;
+        intT cap = (s == sBuffer) ? sCapacity : 0;
+        subCounts[subTid] = len;
+        subworker.localWait();
+        intT o = 0;
+        intT total = 0;
+        for (int i = 0; i < subworker.numOfSub; i++) {
+            if (i == subTid)
+                o = total;
+            total += subCounts[i];
+        }
+        if (total > cap) { // same decision on every subworker
+            if (subworker.isSubMaster())
+                reserveSparse(total);
+            subworker.localWait();
+        }
+        if (len > 0)
+            memcpy(s + o, subBuffers[subTid], sizeof(intT) * len);
+        if (subworker.isSubMaster())
+            m = total;
+        subworker.localWait();
+    }
+
+    // Node-parallel conversions: every subworker of the owning node calls
+    // these and handles its own slice, so the bytes never leave the node.
+    // The caller's next barrier publishes the result.
+    void toSparse(Subworker_Partitioner &subworker) {
+        if (!isDense)
+            return;
+        int subTid = subworker.subTid;
+        int numOfSub = subworker.numOfSub;
+        if (subworker.isSubMaster())
+            reserveSubArrays(numOfSub);
+        subworker.localWait();
+
+        intT startPos, endPos;
+        intT count = 0;
+        if (bits != NULL) {
+            bitmapSlice(n, subTid, numOfSub, startPos, endPos);
+            count = bitmapCountWords(bits, startPos, endPos);
+        } else {
+            startPos = subworker.getStartPos(n);
+            endPos = subworker.getEndPos(n);
+            for (intT i = startPos; i < endPos; i++)
+                count += b[i];
+        }
+        subCounts[subTid] = count;
+        subworker.localWait();
+
+        if (subworker.isSubMaster()) {
+            intT total = 0;
+            for (int i = 0; i < numOfSub; i++) {
+                intT c = subCounts[i];
+                subCounts[i] = total;
+                total += c;
+            }
+            reserveSparse(total);
+            m = total;
+            isDense = false;
+        }
+        subworker.localWait();
+
+        intT o = subCounts[subTid];
+        intT *out = s;
+        if (bits != NULL) {
+            bitmapPackWords(bits, startPos, endPos, out + o, startID);
+        } else {
+            for (intT i = startPos; i < endPos; i++) {
+                if (b[i])
+                    out[o++] = i + startID;
+            }
+        }
+        if (subworker.isSubMaster()) {
+            POLYMER_DEBUG(LOG_FRONTIER, "M is %d\n", m);
+        }
+    }
+
+    void toDense(Subworker_Partitioner &subworker) {
+        if (isDense)
+            return;
+        intT startPos, endPos;
+        if (bits != NULL) {
+            bitmapSlice(n, subworker.subTid, subworker.numOfSub, startPos, endPos);
+            bitmapClearWords(bits, startPos, endPos);
+        } else {
+            startPos = subworker.getStartPos(n);
+            endPos = subworker.getEndPos(n);
+            for (intT i = startPos; i < endPos; i++)
+                b[i] = false;
+        }
+        subworker.localWait();
+        if (subworker.isSubMaster())
+            isDense = true;
+        startPos = subworker.getStartPos(m);
+        endPos = subworker.getEndPos(m);
+        if (bits != NULL) {
+            for (intT i = startPos; i < endPos; i++)
+                bitmapSetAtomic(bits, s[i] - startID);
+        } else {
+            for (intT i = startPos; i < endPos; i++)
+                b[s[i] - startID] = true;
+        }
+    }
+
     void toSparseAsync(int nextID, LocalFrontier* next) {
         if (isDense) {
             if (s != NULL)
                 free(s);
+            sBuffer = NULL;
             _seq<intT> R = sequence::packIndex(b, n);
             s = R.A;
             m = R.n;
@@ -687,9 +953,9 @@ struct LocalFrontier {
                 parallel_for (intT i = 0; i < m; i++) s[i] = s[i] + startID;
             }
             if (m == 0) {
-                printf("%p\n", s);
+                POLYMER_DEBUG(LOG_FRONTIER, "%p\n", s);
             } else {
-                printf("M is %d and first ele is %d\n", m, s[0]);
+                POLYMER_DEBUG(LOG_FRONTIER, "M is %d and first ele is %d\n", m, s[0]);
             }
             AsyncChunk *myChunk = (AsyncChunk *)malloc(sizeof(AsyncChunk));
             myChunk->s = R.A;
@@ -704,7 +970,12 @@ struct LocalFrontier {
     }
 
     void toDense() {
-        if (!isDense) {
+        if (!isDense && bits != NULL) {
+            bitmapClearWords(bits, 0, bitmapWords(n));
+            {
+                parallel_for(intT i=0; i<m; i++) bitmapSetAtomic(bits, s[i] - startID);
+            }
+        } else if (!isDense) {
             {
                 parallel_for(intT i=0; i<n; i++) b[i] = false;
             }
@@ -737,6 +1008,7 @@ struct LocalFrontier {
         if (s != NULL) {
             free(s);
         }
+        sBuffer = NULL;
         m = _m;
         s = _s;
         isDense = false;
@@ -749,10 +1021,10 @@ struct LocalFrontier {
     }
 
     void clearFrontier() {
-        if (s != NULL) {
+        if (s != NULL && s != sBuffer) {
             free(s);
+            s = NULL;
         }
-        s = NULL;
         m = 0;
         outEdgesCount = 0;
     }
@@ -774,10 +1046,13 @@ struct vertices {
     AsyncChunk **asyncQueue;
     int asyncEndSignal;
     intT readerTail;
+    intT asyncLiveChunks; // chunks of edgeMapSparseAsyncPipe not yet retired
     intT insertTail;
+    StealScheduler steal; // ranges of the dense work-stealing kernels
+    EdgeMapTuner tuner;   // dense/sparse choice of edgeMap
 
     vertices(int _numOfNodes) {
-        printf("Polymer - struct vertices\n");
+        POLYMER_TRACE(LOG_FRONTIER, "Polymer - struct vertices\n");
 
         this->numOfNodes = _numOfNodes;
         d = (bool **)malloc(numOfNodes * sizeof(bool*));
@@ -789,6 +1064,8 @@ struct vertices {
         numOfVertices = 0;
         m = -1;
         firstSparse = false;
+        steal.init(numOfNodes);
+        tuner.init();
     }
     /*
     void registerArr(int nodeNum, bool *arr, int size) {
@@ -796,6 +1073,20 @@ struct vertices {
     numOfVertexOnNode[nodeNum] = size;
     }
     */
+    // whether this edgeMap call runs the dense kernel, see polymer-tuner.h
+    bool useDense(Subworker_Partitioner &subworker, long long work, intT threshold) {
+        return tuner.decide(subworker.edgeMapCalls++, subworker.isMaster(), work, threshold);
+    }
+
+    // brackets the kernel of the current edgeMap call for the tuner
+    long long kernelStart(Subworker_Partitioner &subworker) {
+        return tuner.kernelStart(subworker.edgeMapCalls - 1, subworker.isMaster());
+    }
+
+    void kernelEnd(Subworker_Partitioner &subworker, long long start) {
+        tuner.kernelEnd(subworker.edgeMapCalls - 1, start);
+    }
+
     void registerFrontier(int nodeNum, LocalFrontier *frontier) {
         frontiers[nodeNum] = frontier;
         numOfVertexOnNode[nodeNum] = frontier->n;
@@ -840,6 +1131,23 @@ struct vertices {
         }
     }
 
+    // Each node converts its own frontier with its own subworkers; the
+    // master only updates the summary flags, which nobody reads until the
+    // caller's next global barrier.
+    void toDense(Subworker_Partitioner &subworker) {
+        if (subworker.isMaster())
+            isDense = true;
+        frontiers[subworker.tid]->toDense(subworker);
+    }
+
+    void toSparse(Subworker_Partitioner &subworker) {
+        if (subworker.isMaster()) {
+            firstSparse = isDense;
+            isDense = false;
+        }
+        frontiers[subworker.tid]->toSparse(subworker);
+    }
+
     void toSparseAsync() {
         if (!isDense) {
             firstSparse = false;
@@ -948,7 +1256,7 @@ struct vertices {
             accum += numOfVertexOnNode[i];
             i++;
         }
-        *(frontiers[i]->b + (index - accum)) = bit;
+        frontiers[i]->setBit(index - accum + frontiers[i]->startID, bit);
     }
 
     bool getBit(int index) {
@@ -958,7 +1266,7 @@ struct vertices {
             accum += numOfVertexOnNode[i];
             i++;
         }
-        return *(frontiers[i]->b + (index - accum));
+        return frontiers[i]->getBit(index - accum + frontiers[i]->startID);
     }
 
     bool *getArr(int nodeNum) {
@@ -970,6 +1278,16 @@ struct vertices {
         return nextFrontiers[nodeNum]->b;
     }
 
+    // bool array or bitmap of a node's frontier, for kernels that take both
+    FrontierBits getBits(int nodeNum) {
+        return frontiers[nodeNum]->view();
+    }
+
+    FrontierBits getNextBits(int nodeNum) {
+        if (nextFrontiers[nodeNum] == NULL) return FrontierBits();
+        return nextFrontiers[nodeNum]->view();
+    }
+
     intT *getSparseArr(int nodeNum) {
         return frontiers[nodeNum]->s;
     }
@@ -1002,8 +1320,44 @@ struct vertices {
     }
 };
 
+// Walks the sparse arrays of all nodes as one list of numNonzeros()
+// entries, starting at index (which must be below numNonzeros()).
+struct SparseCursor {
+    vertices *frontier;
+    int nodeNum;
+    intT *arr;
+    intT pos;
+    intT left;
+
+    SparseCursor(vertices *_frontier, intT index):frontier(_frontier) {
+        nodeNum = frontier->getNodeNumOfSparseIndex(index);
+        intT offset = 0;
+        for (int i = 0; i < nodeNum; i++) {
+            offset += frontier->getSparseSize(i);
+        }
+        arr = frontier->getSparseArr(nodeNum);
+        pos = index - offset;
+        left = frontier->getSparseSize(nodeNum) - pos;
+    }
+
+    inline intT next() {
+        while (left <= 0 && nodeNum + 1 < frontier->numOfNodes) {
+            nodeNum++;
+            arr = frontier->getSparseArr(nodeNum);
+            pos = 0;
+            left = frontier->getSparseSize(nodeNum);
+        }
+        if (left <= 0) {
+            POLYMER_ERROR(LOG_EDGEMAP, "oops\n");
+        }
+        left--;
+        return arr[pos++];
+    }
+};
+
 struct Default_worker_arg {
     void *GA;
+    void *localGraph; // this node's graph from graphFilter2DirectionAllNodes
     int maxIter;
     int tid;
     int numOfNode;
@@ -1044,26 +1398,75 @@ enum options {
 
 Subworker_Partitioner dummyPartitioner(1);
 
+#include "polymer-runtime.h"
+
 
 //*****EDGE FUNCTIONS*****
 
-template <class F, class vertex>
-bool* edgeMapDense(graph<vertex> GA, vertices* frontier, F f, LocalFrontier *next, bool parallel = 0, Subworker_Partitioner &subworker = dummyPartitioner) {
-    printf("Polymer - edgeMapDense\n");
+// Ownership of the destination a pull kernel writes.  Every node pulls into
+// the whole vertex range from its own sources, so a destination is shared
+// by the nodes even though one subworker per node owns it; only with a
+// single node is it written by no other thread.  An exclusive destination
+// goes through the functor's plain update/combineFuncPlain, a shared one
+// through updateAtomic/combineFunc.
+template <bool exclusive>
+struct TargetOwnership {};
+typedef TargetOwnership<true> ExclusiveTarget;
+typedef TargetOwnership<false> SharedTarget;
 
-    intT numVertices = GA.n;
-    intT size = next->endID - next->startID;
-    vertex *G = GA.V;
+template <class F>
+inline bool updateTarget(F &f, intT s, intT d, SharedTarget) {
+    return f.updateAtomic(s, d);
+}
 
-    if (subworker.isSubMaster()) {
-        frontier->nextFrontiers[subworker.tid] = next;
+template <class F>
+inline bool updateTarget(F &f, intT s, intT d, ExclusiveTarget) {
+    return f.update(s, d);
+}
+
+template <class F, class A>
+inline bool combineTarget(F &f, const A &acc, intT d, SharedTarget) {
+    return f.combineFunc(acc, d);
+}
+
+template <class F, class A>
+inline bool combineTarget(F &f, const A &acc, intT d, ExclusiveTarget) {
+    return f.combineFuncPlain(acc, d);
+}
+
+// Reducer concept of edgeMapDenseReduce.  The functor declares
+//
+//   typedef ... Accum;                                 per destination state
+//   void initFunc(Accum &acc, intT d);                 identity for d
+//   bool reduceFunc(Accum &acc, intT s);               folds in source s, true activates d
+//   bool combineFunc(const Accum &acc, intT d);        finalizes into a shared d
+//   bool combineFuncPlain(const Accum &acc, intT d);   finalizes into an owned d
+//
+// The accumulator is a local of the kernel, so the compiler can keep it in
+// registers, and it can be as wide as the algorithm needs.
+template <class F>
+struct ReducerCheck {
+    typedef typename F::Accum Accum;
+
+    static void check() {
+        void (F::*init)(Accum &, intT) = &F::initFunc;
+        bool (F::*reduce)(Accum &, intT) = &F::reduceFunc;
+        bool (F::*combine)(const Accum &, intT) = &F::combineFunc;
+        bool (F::*combinePlain)(const Accum &, intT) = &F::combineFuncPlain;
+        (void)init;
+        (void)reduce;
+        (void)combine;
+        (void)combinePlain;
     }
+};
 
-    subworker.globalWait();
+// pull over the subworker's dense range
+template <class F, class vertex, class Own>
+void edgeMapDensePull(vertex *G, vertices *frontier, F &f, LocalFrontier *next, Subworker_Partitioner &subworker, Own own) {
     int localOffset = next->startID;
-    bool *localBitVec = frontier->getArr(subworker.tid);
+    FrontierBits localBitVec = frontier->getBits(subworker.tid);
     int currNodeNum = 0;
-    bool *currBitVector = frontier->getNextArr(currNodeNum);
+    FrontierBits currBitVector = frontier->getNextBits(currNodeNum);
     int nextSwitchPoint = frontier->getSize(0);
     int currOffset = 0;
     int counter = 0;
@@ -1075,35 +1478,57 @@ bool* edgeMapDense(graph<vertex> GA, vertices* frontier, F f, LocalFrontier *nex
         currOffset += frontier->getSize(currNodeNum);
         nextSwitchPoint += frontier->getSize(currNodeNum + 1);
         currNodeNum++;
-        currBitVector = frontier->getArr(currNodeNum);
+        currBitVector = frontier->getBits(currNodeNum);
     }
 
+    EdgePrefetcher<vertex, F, true> prefetcher(G, f, startPos, endPos);
     for (intT i = startPos; i < endPos; i++) {
         //next->setBit(i, false);
-        if (f.cond(i)) {
+        if (functorCond(f, i)) {
             intT d = G[i].getFakeInDegree();
+            prefetcher.startVertex(i);
             for(intT j=0; j<d; j++) {
+                prefetcher.edge();
                 intT ngh = G[i].getInNeighbor(j);
-                if (localBitVec[ngh - localOffset] && f.updateAtomic(ngh,i)) {
-                    currBitVector[i - currOffset] = true;
+                if (localBitVec.get(ngh - localOffset) && updateTarget(f, ngh, i, own) && FunctorTraits<F>::producesFrontier) {
+                    currBitVector.set(i - currOffset);
                 }
-                if(!f.cond(i)) break;
-                //__builtin_prefetch(f.nextPrefetchAddr(G[i].getInNeighbor(j+3)), 1, 3);
+                if(!functorCond(f, i)) break;
             }
         }
     }
+}
+
+template <class F, class vertex>
+bool* edgeMapDense(graph<vertex> GA, vertices* frontier, F f, LocalFrontier *next, bool parallel = 0, Subworker_Partitioner &subworker = dummyPartitioner) {
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapDense\n");
+
+    intT numVertices = GA.n;
+    intT size = next->endID - next->startID;
+    vertex *G = GA.V;
+
+    if (subworker.isSubMaster()) {
+        frontier->nextFrontiers[subworker.tid] = next;
+    }
+
+    subworker.globalWait();
+    if (frontier->numOfNodes == 1)
+        edgeMapDensePull(G, frontier, f, next, subworker, ExclusiveTarget());
+    else
+        edgeMapDensePull(G, frontier, f, next, subworker, SharedTarget());
     return NULL;
 }
 
+
 template <class F, class vertex>
 bool* edgeMapDenseForward(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, bool part = false, int start = 0, int end = 0) {
-    printf("Polymer - edgeMapDenseForward\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapDenseForward\n");
 
     intT numVertices = GA.n;
     vertex *G = GA.V;
 
     int currNodeNum = 0;
-    bool *currBitVector = frontier->getArr(currNodeNum);
+    FrontierBits currBitVector = frontier->getBits(currNodeNum);
     int nextSwitchPoint = frontier->getSize(0);
     int currOffset = 0;
     int counter = 0;
@@ -1119,25 +1544,28 @@ bool* edgeMapDenseForward(graph<vertex> GA, vertices *frontier, F f, LocalFronti
         endPos = end;
         currNodeNum = frontier->getNodeNumOfIndex(startPos);
         //printf("nodeNum: %d %d\n", currNodeNum, endPos);
-        currBitVector = frontier->getArr(currNodeNum);
+        currBitVector = frontier->getBits(currNodeNum);
         nextSwitchPoint = frontier->getOffset(currNodeNum+1);
         currOffset = frontier->getOffset(currNodeNum);
     }
+    EdgePrefetcher<vertex, F, false> prefetcher(G, f, startPos, endPos);
     for (long i=startPos; i<endPos; i++) {
         if (i == nextSwitchPoint) {
             currOffset += frontier->getSize(currNodeNum);
             nextSwitchPoint += frontier->getSize(currNodeNum + 1);
             currNodeNum++;
-            currBitVector = frontier->getArr(currNodeNum);
+            currBitVector = frontier->getBits(currNodeNum);
             //printf("OK\n");
         }
         //printf("edgemap: %p\n", currBitVector);
         m += G[i].getFakeDegree();
-        if (currBitVector[i-currOffset]) {
+        if (currBitVector.get(i-currOffset)) {
             intT d = G[i].getFakeDegree();
+            prefetcher.startVertex(i);
             for(intT j=0; j<d; j++) {
+                prefetcher.edge();
                 uintT ngh = G[i].getOutNeighbor(j);
-                if (/*next->inRange(ngh) &&*/ f.cond(ngh) && f.updateAtomic(i,ngh)) {
+                if (/*next->inRange(ngh) &&*/ functorCond(f, ngh) && f.updateAtomic(i, ngh) && FunctorTraits<F>::producesFrontier) {
                     /*
                     if (!next->getBit(ngh)) {
                     m++;
@@ -1148,11 +1576,8 @@ bool* edgeMapDenseForward(graph<vertex> GA, vertices *frontier, F f, LocalFronti
                     //m += 1 - SXCHG((char *)&(nextB[idx]), 1);
                     next->setBit(ngh, true);
                 }
-                //__builtin_prefetch(f.nextPrefetchAddr(G[i].getOutNeighbor(j+1)), 1, 0);
             }
         }
-        //__builtin_prefetch(f.nextPrefetchAddr(i+1), 0, 3);
-        //__builtin_prefetch(G[i+3].getOutNeighborPtr(), 0, 3);
     }
     //writeAdd(&(next->m), m);
     //writeAdd(&(next->outEdgesCount), outEdgesCount);
@@ -1163,91 +1588,131 @@ bool* edgeMapDenseForward(graph<vertex> GA, vertices *frontier, F f, LocalFronti
 
 #define DYNAMIC_CHUNK_SIZE (64)
 
+// Locates the node owning vertex index idx of the dense frontier and the
+// index range of that node.
+inline int denseNodeOfIndex(vertices *frontier, intT idx, intT &nodeStart, intT &nodeEnd) {
+    int nodeNum = 0;
+    nodeStart = 0;
+    nodeEnd = frontier->getSize(0);
+    while (idx >= nodeEnd && nodeNum + 1 < frontier->numOfNodes) {
+        nodeNum++;
+        nodeStart = nodeEnd;
+        nodeEnd += frontier->getSize(nodeNum);
+    }
+    return nodeNum;
+}
+
+// push over the sources [startPos, endPos) of one node's graph
+template <class F, class vertex>
+inline void edgeMapDenseForwardChunk(vertex *G, F &f, vertices *frontier, LocalFrontier *next, intT startPos, intT endPos) {
+    intT currOffset, nextSwitchPoint;
+    int currNodeNum = denseNodeOfIndex(frontier, startPos, currOffset, nextSwitchPoint);
+    FrontierBits currBitVector = frontier->getBits(currNodeNum);
+    EdgePrefetcher<vertex, F, false> prefetcher(G, f, startPos, endPos);
+    for (intT i = startPos; i < endPos; i++) {
+        if (i == nextSwitchPoint) {
+            currNodeNum = denseNodeOfIndex(frontier, i, currOffset, nextSwitchPoint);
+            currBitVector = frontier->getBits(currNodeNum);
+        }
+        if (currBitVector.get(i - currOffset)) {
+            intT d = G[i].getFakeDegree();
+            prefetcher.startVertex(i);
+            for (intT j = 0; j < d; j++) {
+                prefetcher.edge();
+                uintT ngh = G[i].getOutNeighbor(j);
+                if (functorCond(f, ngh) && f.updateAtomic(i, ngh) && FunctorTraits<F>::producesFrontier) {
+                    next->setBit(ngh, true);
+                }
+            }
+        }
+    }
+}
+
 template <class F, class vertex>
 bool* edgeMapDenseForwardDynamic(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, Subworker_Partitioner &subworker=dummyPartitioner) {
-    printf("Polymer - edgeMapDenseForwardDynamic\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapDenseForwardDynamic\n");
 
-    intT numVertices = GA.n;
-    vertex *G = GA.V;
+    int tid = subworker.tid;
+    StealScheduler &steal = frontier->steal;
     if (subworker.isMaster()) {
-        printf("we are here\n");
+        steal.reset(subworker.numOfSub, GA.n, DYNAMIC_CHUNK_SIZE);
     }
-    int currNodeNum = 0;
-    bool *currBitVector = frontier->getArr(currNodeNum);
-    int nextSwitchPoint = frontier->getSize(0);
-    int currOffset = 0;
-    int counter = 0;
-
-    intT m = 0;
-    intT outEdgesCount = 0;
-    bool *nextB = next->b;
-
-    intT *counterPtr = &(next->sparseCounter);
-
-    intT oldStartPos = 0;
-
-    intT startPos = __sync_fetch_and_add(counterPtr, DYNAMIC_CHUNK_SIZE);
-    intT endPos = (startPos + DYNAMIC_CHUNK_SIZE > numVertices) ? (numVertices) : (startPos + DYNAMIC_CHUNK_SIZE);
-    while (startPos < numVertices) {
-        m = 0;
-        while (startPos >= nextSwitchPoint) {
-            currOffset += frontier->getSize(currNodeNum);
-            nextSwitchPoint += frontier->getSize(currNodeNum + 1);
-            currNodeNum++;
-            currBitVector = frontier->getArr(currNodeNum);
-        }
-        for (long i=startPos; i<endPos; i++) {
-            if (i == nextSwitchPoint) {
-                currOffset += frontier->getSize(currNodeNum);
-                nextSwitchPoint += frontier->getSize(currNodeNum + 1);
-                currNodeNum++;
-                currBitVector = frontier->getArr(currNodeNum);
-            }
-            m += G[i].getFakeDegree();
-            if (currBitVector[i-currOffset]) {
-                intT d = G[i].getFakeDegree();
-                for(intT j=0; j<d; j++) {
-                    uintT ngh = G[i].getOutNeighbor(j);
-                    if (f.cond(ngh) && f.updateAtomic(i, ngh)) {
-                        next->setBit(ngh, true);
-                    }
-                }
-            }
-        }
+    if (subworker.isSubMaster()) {
+        frontier->nextFrontiers[tid] = next;
+        steal.nodeGraphs[tid] = (void *)GA.V;
+        steal.nodeFuncs[tid] = (void *)&f;
+    }
+    subworker.globalWait();
 
-        if (subworker.tid == 7) {
-            //printf("%d: %d to %d deg: %d\n", subworker.subTid, startPos, endPos, m);
+    intT startPos, endPos;
+    int owner;
+    while ((owner = steal.next(tid, subworker.subTid, startPos, endPos)) >= 0) {
+        if (owner == tid) {
+            edgeMapDenseForwardChunk(GA.V, f, frontier, next, startPos, endPos);
+        } else {
+            edgeMapDenseForwardChunk((vertex *)steal.nodeGraphs[owner], *(F *)steal.nodeFuncs[owner],
+                                     frontier, frontier->nextFrontiers[owner], startPos, endPos);
         }
-
-        oldStartPos = startPos;
-        startPos = __sync_fetch_and_add(counterPtr, DYNAMIC_CHUNK_SIZE);
-        endPos = (startPos + DYNAMIC_CHUNK_SIZE > numVertices) ? (numVertices) : (startPos + DYNAMIC_CHUNK_SIZE);
     }
+    // stolen chunks use the graphs and functors of other nodes, which must
+    // stay alive until everyone is done
+    subworker.globalWait();
     return NULL;
 }
 
+// Dense edgeMap for algorithms that keep every vertex active, such as
+// PageRank.  There is no frontier to test or produce: the subworker streams
+// the out-edges of its dense range of the node's graph in order and reads
+// the source value once per vertex.  The functor provides
+//
+//   typedef ... Value;
+//   Value sourceValue(intT s);                    what s sends along each edge
+//   void updateValue(const Value &val, intT d);   adds it into d, atomically
+//
+// as the subworkers of a node share its destinations.
 template <class F, class vertex>
-bool* edgeMapDenseReduce(graph<vertex> GA, vertices* frontier, F f, LocalFrontier *next, bool parallel = 0, Subworker_Partitioner &subworker = dummyPartitioner) {
-    printf("Polymer - edgeMapDenseReduce\n");
+void edgeMapAll(graph<vertex> GA, F f, Subworker_Partitioner &subworker) {
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapAll\n");
 
-    intT numVertices = GA.n;
-    intT size = next->endID - next->startID;
     vertex *G = GA.V;
-
-    if (subworker.isSubMaster()) {
-        frontier->nextFrontiers[subworker.tid] = next;
+    for (intT i = subworker.dense_start; i < subworker.dense_end; i++) {
+        intT d = G[i].getFakeDegree();
+        if (d == 0)
+            continue;
+        typename F::Value val = f.sourceValue(i);
+        for (intT j = 0; j < d; j++) {
+            f.updateValue(val, G[i].getOutNeighbor(j));
+        }
     }
+}
 
-    subworker.globalWait();
+// Pull flavour of edgeMapAll for sums such as PageRank.  Every destination
+// of the subworker's dense range adds up sourceValues()[s] over its
+// in-neighbours s in the node's graph with the gathers of polymer-simd.h,
+// then hands the sum to addValue(sum, d), which must be atomic as the other
+// nodes pull into the same destinations.
+template <class F, class vertex>
+void edgeMapAllPull(graph<vertex> GA, F f, Subworker_Partitioner &subworker) {
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapAllPull\n");
 
-    struct timeval startT, endT;
-    struct timezone tz = {0, 0};
-    gettimeofday(&startT, &tz);
+    vertex *G = GA.V;
+    const double *vals = f.sourceValues();
+    GatherSumFunc gatherSum = simdKernels().gatherSum;
+    for (intT i = subworker.dense_start; i < subworker.dense_end; i++) {
+        intT d = G[i].getFakeInDegree();
+        if (d > 0)
+            f.addValue(gatherSum(vals, G[i].getInNeighborPtr(), d), i);
+    }
+}
 
+// pull over the subworker's dense range, reducing into a local value that
+// is combined into the destination once
+template <class F, class vertex, class Own>
+void edgeMapDenseReducePull(vertex *G, vertices *frontier, F &f, LocalFrontier *next, Subworker_Partitioner &subworker, Own own) {
     int localOffset = next->startID;
-    bool *localBitVec = frontier->getArr(subworker.tid);
+    FrontierBits localBitVec = frontier->getBits(subworker.tid);
     int currNodeNum = 0;
-    bool *currBitVector = frontier->getNextArr(currNodeNum);
+    FrontierBits currBitVector = frontier->getNextBits(currNodeNum);
     int nextSwitchPoint = frontier->getSize(0);
     int currOffset = 0;
     int counter = 0;
@@ -1259,152 +1724,151 @@ bool* edgeMapDenseReduce(graph<vertex> GA, vertices* frontier, F f, LocalFrontie
         currOffset += frontier->getSize(currNodeNum);
         nextSwitchPoint += frontier->getSize(currNodeNum + 1);
         currNodeNum++;
-        currBitVector = frontier->getNextArr(currNodeNum);
+        currBitVector = frontier->getNextBits(currNodeNum);
     }
 
+    EdgePrefetcher<vertex, F, true> prefetcher(G, f, startPos, endPos);
     for (intT i = startPos; i < endPos; i++) {
         //next->setBit(i, false);
         if (i >= nextSwitchPoint) {
             currOffset += frontier->getSize(currNodeNum);
             nextSwitchPoint += frontier->getSize(currNodeNum + 1);
             currNodeNum++;
-            currBitVector = frontier->getNextArr(currNodeNum);
+            currBitVector = frontier->getNextBits(currNodeNum);
         }
-        if (f.cond(i)) {
-            double data[2];
+        if (functorCond(f, i)) {
+            typename F::Accum acc;
             intT d = G[i].getFakeInDegree();
-            f.initFunc((void *)data, i);
+            f.initFunc(acc, i);
             bool shouldActive = false;
+            prefetcher.startVertex(i);
             for(intT j=0; j<d; j++) {
+                prefetcher.edge();
                 intT ngh = G[i].getInNeighbor(j);
-                if (localBitVec[ngh - localOffset] && f.reduceFunc((void *)data, ngh)) {
-                    currBitVector[i - currOffset] = true;
-                    //shouldActive = true;
+                if (localBitVec.get(ngh - localOffset) && f.reduceFunc(acc, ngh)) {
+                    shouldActive = true;
                 }
-                if(!f.cond(i)) break;
-                //__builtin_prefetch(f.nextPrefetchAddr(G[i].getInNeighbor(j+3)), 1, 3);
+                if(!functorCond(f, i)) break;
+            }
+            if (shouldActive && FunctorTraits<F>::producesFrontier) {
+                currBitVector.set(i - currOffset);
             }
             if (d > 0) {
-                f.combineFunc((void *)data, i);
+                combineTarget(f, acc, i, own);
             }
         }
     }
-
-    subworker.localWait();
-    gettimeofday(&endT, &tz);
-    if (subworker.isSubMaster()) {
-        double time1 = ((double)startT.tv_sec) + ((double)startT.tv_usec) / 1000000.0;
-        double time2 = ((double)endT.tv_sec) + ((double)endT.tv_usec) / 1000000.0;
-        double duration = time2 - time1;
-        //printf("time of %d: %lf\n", subworker.tid, duration);
-    }
-    return NULL;
 }
 
 template <class F, class vertex>
-bool* edgeMapDenseDynamic(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, Subworker_Partitioner &subworker=dummyPartitioner) {
-    printf("Polymer - edgeMapDenseDynamic\n");
+bool* edgeMapDenseReduce(graph<vertex> GA, vertices* frontier, F f, LocalFrontier *next, bool parallel = 0, Subworker_Partitioner &subworker = dummyPartitioner) {
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapDenseReduce\n");
+    ReducerCheck<F>::check();
 
     intT numVertices = GA.n;
+    intT size = next->endID - next->startID;
     vertex *G = GA.V;
-    if (subworker.isMaster()) {
-        //printf("we are here\n");
-    }
 
     if (subworker.isSubMaster()) {
         frontier->nextFrontiers[subworker.tid] = next;
     }
 
     subworker.globalWait();
-    int localOffset = next->startID;
-    bool *localBitVec = frontier->getArr(subworker.tid);
-    int currNodeNum = 0;
-    bool *currBitVector = frontier->getNextArr(currNodeNum);
-    int nextSwitchPoint = frontier->getSize(0);
-    int currOffset = 0;
-    int counter = 0;
-
-    intT m = 0;
-    intT outEdgesCount = 0;
-    bool *nextB = next->b;
 
-    intT chunkSize = numVertices / frontier->numOfNodes;
-    intT rollingOffset = 0;//subworker.tid * chunkSize;
+    struct timeval startT, endT;
+    struct timezone tz = {0, 0};
+    gettimeofday(&startT, &tz);
 
-    intT *counterPtr = &(next->sparseCounter);
+    if (frontier->numOfNodes == 1)
+        edgeMapDenseReducePull(G, frontier, f, next, subworker, ExclusiveTarget());
+    else
+        edgeMapDenseReducePull(G, frontier, f, next, subworker, SharedTarget());
 
-    intT oldStartPos = 0;
+    subworker.localWait();
+    gettimeofday(&endT, &tz);
+    if (subworker.isSubMaster()) {
+        double time1 = ((double)startT.tv_sec) + ((double)startT.tv_usec) / 1000000.0;
+        double time2 = ((double)endT.tv_sec) + ((double)endT.tv_usec) / 1000000.0;
+        double duration = time2 - time1;
+        //printf("time of %d: %lf\n", subworker.tid, duration);
+    }
+    return NULL;
+}
 
-    intT startPos = __sync_fetch_and_add(counterPtr, DYNAMIC_CHUNK_SIZE);
-    intT endPos = (startPos + DYNAMIC_CHUNK_SIZE > numVertices) ? (numVertices) : (startPos + DYNAMIC_CHUNK_SIZE);
-    while (startPos < numVertices) {
-        m = 0;
-        intT actualSize = endPos - startPos;
-        intT actualStart = startPos + rollingOffset;
-        while (actualStart >= nextSwitchPoint) {
-            currOffset += frontier->getSize(currNodeNum);
-            nextSwitchPoint += frontier->getSize(currNodeNum + 1);
-            currNodeNum++;
-            if (currNodeNum >= frontier->numOfNodes) {
-                currNodeNum = 0;
-                currOffset = 0;
-                nextSwitchPoint = frontier->getSize(0) + numVertices;
-                //printf("switch back\n");
-            } else {
-                currBitVector = frontier->getNextArr(currNodeNum);
-            }
-        }
-        for (long i=startPos; i<endPos; i++) {
-            intT idx = (i + rollingOffset) % numVertices;
-            if (i + rollingOffset == nextSwitchPoint) {
-                currOffset += frontier->getSize(currNodeNum);
-                nextSwitchPoint += frontier->getSize(currNodeNum + 1);
-                currNodeNum++;
-                if (currNodeNum >= frontier->numOfNodes) {
-                    currNodeNum = 0;
-                    currOffset = 0;
-                    nextSwitchPoint = frontier->getSize(0) + numVertices;
-                    //printf("switch back\n");
-                } else {
-                    currBitVector = frontier->getNextArr(currNodeNum);
+// pull into the targets [startPos, endPos) from the sources of one node's
+// graph
+template <class F, class vertex, class Own>
+inline void edgeMapDenseDynamicChunk(vertex *G, F &f, vertices *frontier, FrontierBits localBitVec, int localOffset, intT startPos, intT endPos, Own own) {
+    intT currOffset, nextSwitchPoint;
+    int currNodeNum = denseNodeOfIndex(frontier, startPos, currOffset, nextSwitchPoint);
+    FrontierBits currBitVector = frontier->getNextBits(currNodeNum);
+    EdgePrefetcher<vertex, F, true> prefetcher(G, f, startPos, endPos);
+    for (intT idx = startPos; idx < endPos; idx++) {
+        if (idx == nextSwitchPoint) {
+            currNodeNum = denseNodeOfIndex(frontier, idx, currOffset, nextSwitchPoint);
+            currBitVector = frontier->getNextBits(currNodeNum);
+        }
+        if (functorCond(f, idx)) {
+            intT d = G[idx].getFakeInDegree();
+            prefetcher.startVertex(idx);
+            for(intT j=0; j<d; j++) {
+                prefetcher.edge();
+                uintT ngh = G[idx].getInNeighbor(j);
+                if (localBitVec.get(ngh-localOffset) && updateTarget(f, ngh, idx, own) && FunctorTraits<F>::producesFrontier) {
+                    currBitVector.set(idx - currOffset);
                 }
-            }
-            m += G[idx].getFakeInDegree();
-            if (f.cond(idx)) {
-                intT d = G[idx].getFakeInDegree();
-                //printf("in deg of %d: %d\n", idx, d);
-                for(intT j=0; j<d; j++) {
-                    uintT ngh = G[idx].getInNeighbor(j);
-                    if (localBitVec[ngh-localOffset] && f.updateAtomic(ngh, idx)) {
-                        currBitVector[idx - currOffset] = true;
-                    }
-                    if (!f.cond(idx)) {
-                        break;
-                    }
+                if (!functorCond(f, idx)) {
+                    break;
                 }
             }
         }
+    }
+}
 
-        if (subworker.tid == 7) {
-            //printf("%d: %d to %d deg: %d\n", subworker.subTid, startPos, endPos, m);
-        }
+template <class F, class vertex>
+bool* edgeMapDenseDynamic(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, Subworker_Partitioner &subworker=dummyPartitioner) {
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapDenseDynamic\n");
 
-        oldStartPos = startPos;
-        startPos = __sync_fetch_and_add(counterPtr, DYNAMIC_CHUNK_SIZE);
-        endPos = (startPos + DYNAMIC_CHUNK_SIZE > numVertices) ? (numVertices) : (startPos + DYNAMIC_CHUNK_SIZE);
+    int tid = subworker.tid;
+    StealScheduler &steal = frontier->steal;
+    if (subworker.isMaster()) {
+        steal.reset(subworker.numOfSub, GA.n, DYNAMIC_CHUNK_SIZE);
+    }
+    if (subworker.isSubMaster()) {
+        frontier->nextFrontiers[tid] = next;
+        steal.nodeGraphs[tid] = (void *)GA.V;
+        steal.nodeFuncs[tid] = (void *)&f;
     }
+    subworker.globalWait();
+
+    intT startPos, endPos;
+    int owner;
+    while ((owner = steal.next(tid, subworker.subTid, startPos, endPos)) >= 0) {
+        if (owner == tid) {
+            if (frontier->numOfNodes == 1)
+                edgeMapDenseDynamicChunk(GA.V, f, frontier, frontier->getBits(tid), next->startID, startPos, endPos, ExclusiveTarget());
+            else
+                edgeMapDenseDynamicChunk(GA.V, f, frontier, frontier->getBits(tid), next->startID, startPos, endPos, SharedTarget());
+        } else {
+            edgeMapDenseDynamicChunk((vertex *)steal.nodeGraphs[owner], *(F *)steal.nodeFuncs[owner], frontier,
+                                     frontier->getBits(owner), frontier->nextFrontiers[owner]->startID, startPos, endPos, SharedTarget());
+        }
+    }
+    // stolen chunks use the graphs and functors of other nodes, which must
+    // stay alive until everyone is done
+    subworker.globalWait();
     return NULL;
 }
 
 template <class F, class vertex>
 bool* edgeMapDenseBP(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, bool part = false, int start = 0, int end = 0) {
-    printf("Polymer - edgeMapDenseBP\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapDenseBP\n");
 
     intT numVertices = GA.n;
     vertex *G = GA.V;
 
     int currNodeNum = 0;
-    bool *currBitVector = frontier->getArr(currNodeNum);
+    FrontierBits currBitVector = frontier->getBits(currNodeNum);
     int nextSwitchPoint = frontier->getSize(0);
     int currOffset = 0;
     int counter = 0;
@@ -1417,7 +1881,7 @@ bool* edgeMapDenseBP(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
         startPos = start;
         endPos = end;
         currNodeNum = frontier->getNodeNumOfIndex(startPos);
-        currBitVector = frontier->getArr(currNodeNum);
+        currBitVector = frontier->getBits(currNodeNum);
         nextSwitchPoint = frontier->getOffset(currNodeNum+1);
         currOffset = frontier->getOffset(currNodeNum);
     }
@@ -1426,14 +1890,14 @@ bool* edgeMapDenseBP(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
             currOffset += frontier->getSize(currNodeNum);
             nextSwitchPoint += frontier->getSize(currNodeNum + 1);
             currNodeNum++;
-            currBitVector = frontier->getArr(currNodeNum);
+            currBitVector = frontier->getBits(currNodeNum);
         }
         m += G[i].getFakeDegree();
-        if (currBitVector[i-currOffset]) {
+        if (currBitVector.get(i-currOffset)) {
             intT d = G[i].getFakeDegree();
             for(intT j=0; j<d; j++) {
                 uintT ngh = G[i].getOutNeighbor(j);
-                if (/*next->inRange(ngh) &&*/ f.cond(ngh) && f.updateAtomic(i,ngh,j)) {
+                if (/*next->inRange(ngh) &&*/ functorCond(f, ngh) && f.updateAtomic(i,ngh,j)) {
                     next->setBit(ngh, true);
                 }
             }
@@ -1444,12 +1908,12 @@ bool* edgeMapDenseBP(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
 
 template <class F, class vertex>
 bool* edgeMapDenseForwardGlobalWrite(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *nexts[], Subworker_Partitioner &subworker) {
-    printf("Polymer - edgeMapDenseForwardGlobalWrite\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapDenseForwardGlobalWrite\n");
 
     intT numVertices = GA.n;
     vertex *G = GA.V;
 
-    bool *currBitVector = frontier->getArr(subworker.tid);
+    FrontierBits currBitVector = frontier->getBits(subworker.tid);
     int currOffset = frontier->getOffset(subworker.tid);
     int counter = 0;
 
@@ -1462,7 +1926,7 @@ bool* edgeMapDenseForwardGlobalWrite(graph<vertex> GA, vertices *frontier, F f,
     //printf("%d %d: start-end: %d %d\n", subworker.tid, subworker.subTid, startPos, endPos);
 
     int currNodeNum = frontier->getNodeNumOfIndex(startPos);
-    bool *nextBitVector = nexts[currNodeNum]->b;
+    FrontierBits nextBitVector = nexts[currNodeNum]->view();
     intT nextSwitchPoint = frontier->getOffset(currNodeNum+1);
     int offset = frontier->getOffset(currNodeNum);
 
@@ -1471,15 +1935,15 @@ bool* edgeMapDenseForwardGlobalWrite(graph<vertex> GA, vertices *frontier, F f,
             offset += frontier->getSize(currNodeNum);
             nextSwitchPoint += frontier->getSize(currNodeNum + 1);
             currNodeNum++;
-            nextBitVector = nexts[currNodeNum]->b;
+            nextBitVector = nexts[currNodeNum]->view();
         }
         m += G[i].getFakeDegree();
-        if (f.cond(i)) {
+        if (functorCond(f, i)) {
             intT d = G[i].getFakeDegree();
             for(intT j=0; j<d; j++) {
                 uintT ngh = G[i].getInNeighbor(j);
-                if (currBitVector[ngh-currOffset] && f.updateAtomic(ngh, i)) {
-                    nextBitVector[i-offset] = true;
+                if (currBitVector.get(ngh-currOffset) && f.updateAtomic(ngh, i)) {
+                    nextBitVector.set(i-offset);
                 }
             }
         }
@@ -1488,7 +1952,7 @@ bool* edgeMapDenseForwardGlobalWrite(graph<vertex> GA, vertices *frontier, F f,
 }
 
 AsyncChunk *newChunk(int blockSize) {
-    printf("Polymer - newChunk\n");
+    POLYMER_TRACE(LOG_FRONTIER, "Polymer - newChunk\n");
 
     AsyncChunk *myChunk = (AsyncChunk *)malloc(sizeof(AsyncChunk));
     myChunk->s = (intT *)malloc(sizeof(intT) * blockSize);
@@ -1499,7 +1963,7 @@ AsyncChunk *newChunk(int blockSize) {
 
 template <class F, class vertex>
 void edgeMapSparseAsync(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, Subworker_Partitioner &subworker = dummyPartitioner) {
-    printf("Polymer - edgeMapSparseAsync\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapSparseAsync\n");
 
     const int BLOCK_SIZE = 64;
 
@@ -1521,7 +1985,7 @@ void edgeMapSparseAsync(graph<vertex> GA, vertices *frontier, F f, LocalFrontier
     *endSignal = 0;
     pthread_barrier_wait(subworker.local_barr);
     if (subworker.isSubMaster()) {
-        printf("passed barrier\n");
+        POLYMER_TRACE(LOG_EDGEMAP, "passed barrier\n");
     }
     int accumSize = 0;
     AsyncChunk *myChunk = newChunk(BLOCK_SIZE);
@@ -1534,7 +1998,7 @@ void edgeMapSparseAsync(graph<vertex> GA, vertices *frontier, F f, LocalFrontier
         AsyncChunk *currChunk = NULL;
         /*
         if (*endSignal == 1) {
-            printf("spin: %d %d %d %d %d\n", subworker.tid, subworker.subTid, currHead, currTail, endPos);
+            POLYMER_TRACE(LOG_EDGEMAP, "spin: %d %d %d %d %d\n", subworker.tid, subworker.subTid, currHead, currTail, endPos);
         }
         */
         do {
@@ -1555,7 +2019,7 @@ void edgeMapSparseAsync(graph<vertex> GA, vertices *frontier, F f, LocalFrontier
             //process chunk
             currChunk = frontier->asyncQueue[currHead % GA.n];
             if (currChunk == NULL) {
-                printf("oops: %p %p %d %d %d\n", currChunk, frontier->asyncQueue[currHead % GA.n], currHead, currTail, endPos);
+                POLYMER_ERROR(LOG_EDGEMAP, "oops: %p %p %d %d %d\n", currChunk, frontier->asyncQueue[currHead % GA.n], currHead, currTail, endPos);
             }
             //printf("chunk pointer: %p\n", currChunk);
             int chunkSize = currChunk->m;
@@ -1565,7 +2029,7 @@ void edgeMapSparseAsync(graph<vertex> GA, vertices *frontier, F f, LocalFrontier
                 intT d = V[idx].getOutDegree();
                 for (intT j = 0; j < d; j++) {
                     intT ngh = V[idx].getOutNeighbor(j);
-                    if (f.cond(ngh) && f.updateAtomic(idx, ngh)) {
+                    if (functorCond(f, ngh) && f.updateAtomic(idx, ngh)) {
                         //add ngh into chunk
                         myChunk->s[myChunk->m] = ngh;
                         myChunk->m += 1;
@@ -1574,14 +2038,14 @@ void edgeMapSparseAsync(graph<vertex> GA, vertices *frontier, F f, LocalFrontier
                             intT insertPos = __sync_fetch_and_add(insertTail, 1);
                             /*
                             if (*endSignal == 1)
-                            printf("before insert %d %d %d\n", *queueTail, insertPos, *insertTail);
+                            POLYMER_TRACE(LOG_EDGEMAP, "before insert %d %d %d\n", *queueTail, insertPos, *insertTail);
                             */
                             frontier->asyncQueue[insertPos % GA.n] = myChunk;
                             //__asm__ __volatile__ ("mfence\n":::);
                             while (!__sync_bool_compare_and_swap((intT *)queueTail, insertPos, insertPos+1)) {
                                 if (*queueTail > insertPos) {
                                     break;
-                                    printf("pending on insert %d %d %d\n", *queueTail, insertPos, *insertTail);
+                                    POLYMER_TRACE(LOG_EDGEMAP, "pending on insert %d %d %d\n", *queueTail, insertPos, *insertTail);
                                 }
 
                             }
@@ -1610,7 +2074,7 @@ void edgeMapSparseAsync(graph<vertex> GA, vertices *frontier, F f, LocalFrontier
                 while (!__sync_bool_compare_and_swap((intT *)queueTail, insertPos, insertPos+1)) {
                     if (*queueTail > insertPos) {
                         break;
-                        printf("pending on insert %d %d %d\n", *queueTail, insertPos, *insertTail);
+                        POLYMER_TRACE(LOG_EDGEMAP, "pending on insert %d %d %d\n", *queueTail, insertPos, *insertTail);
                     }
                 }
                 //printf("insert over: %d %d\n", insertPos, *queueTail);
@@ -1641,7 +2105,7 @@ void edgeMapSparseAsync(graph<vertex> GA, vertices *frontier, F f, LocalFrontier
                     *(signals[i]) = 1;
                     if (marker > frontier->numOfNodes) {
                         *endSignal = 1;
-                        printf("master out\n");
+                        POLYMER_TRACE(LOG_EDGEMAP, "master out\n");
                         shouldFinish = true;
                         break;
                     }
@@ -1655,7 +2119,7 @@ void edgeMapSparseAsync(graph<vertex> GA, vertices *frontier, F f, LocalFrontier
 
 template <class F, class vertex>
 void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, Subworker_Partitioner &subworker = dummyPartitioner) {
-    printf("Polymer - edgeMapSparseAsyncPipe\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapSparseAsyncPipe\n");
 
     const int BLOCK_SIZE = 64;
     vertex *V = GA.V;
@@ -1671,18 +2135,16 @@ void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFron
     volatile intT *localTail = &(frontier->frontiers[tid]->tail);
     volatile intT *nextTail = &(frontier->frontiers[(tid + 1) % frontier->numOfNodes]->tail);
     volatile intT *insertTail = &(frontier->frontiers[(tid + 1) % frontier->numOfNodes]->insertTail);
-    volatile intT *localSignal = &(frontier->frontiers[tid]->emptySignal);
-    volatile intT *endSignal = &(frontier->asyncEndSignal);
-    volatile intT *endGameOnFly = &(frontier->readerTail);
-    volatile intT *signals[frontier->numOfNodes];
-    for (int i = 0; i < frontier->numOfNodes; i++) {
-        signals[i] = &(frontier->frontiers[i]->emptySignal);
-    }
+    volatile intT *liveChunks = &(frontier->asyncLiveChunks);
     *localHead = 0;
     *insertTail = *nextTail;
-    *localSignal = 0;
-    *endSignal = 0;
-    *endGameOnFly = 0;
+    if (subworker.isMaster()) {
+        // the chunks the caller seeded the queues with
+        *liveChunks = 0;
+        for (int i = 0; i < frontier->numOfNodes; i++) {
+            *liveChunks += frontier->frontiers[i]->tail;
+        }
+    }
 
     int offset = frontier->getOffset(tid);
     int *bitVec = frontier->frontiers[tid]->tmp;
@@ -1698,12 +2160,13 @@ void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFron
         bitVec[i] = 0;
     }
 
-    pthread_barrier_wait(subworker.local_barr);
+    // the queues and the chunk count above are shared, so no node may
+    // start sending before all of them are reset
+    subworker.globalWait();
 
     int accumSize = 0;
     AsyncChunk *myChunk = newChunk(BLOCK_SIZE);
     bool shouldFinish = false;
-    *localSignal = 0;
     while (!shouldFinish) {
         volatile intT currHead = 0;
         volatile intT currTail = 0;
@@ -1718,21 +2181,21 @@ void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFron
 
         int reallyGotOne = endPos - currHead;
         if (reallyGotOne > 0) {
-            *localSignal = 0;
-
             currChunk = localQueue[currHead % GA.n];
             int chunkSize = currChunk->m;
             if (chunkSize > 0) {
                 for (intT i = 0; i < chunkSize; i++) {
                     accumSize++;
                     intT idx = currChunk->s[i];
-                    intT d = V[idx].getOutDegree();
+                    intT d = V[idx].getFakeDegree();
                     for (intT j = 0; j < d; j++) {
                         intT ngh = V[idx].getOutNeighbor(j);
-                        if (f.cond(ngh) && f.updateAtomic(idx, ngh)) {
+                        if (functorCond(f, ngh) && f.updateAtomic(idx, ngh)) {
                             //add ngh into chunk
                             int counter = __sync_fetch_and_add(&(bitVec[ngh - offset]), 1);
                             if (counter == 0) {
+                                if (myChunk->m == 0)
+                                    __sync_fetch_and_add(liveChunks, 1);
                                 myChunk->s[myChunk->m] = ngh;
                                 myChunk->m += 1;
                                 if (myChunk->m >= BLOCK_SIZE) {
@@ -1743,7 +2206,7 @@ void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFron
                                     while (!__sync_bool_compare_and_swap((intT *)nextTail, insertPos, insertPos+1)) {
                                         if (*nextTail > insertPos) {
                                             break;
-                                            printf("pending on insert %d %d %d\n", *nextTail, insertPos, *insertTail);
+                                            POLYMER_TRACE(LOG_EDGEMAP, "pending on insert %d %d %d\n", *nextTail, insertPos, *insertTail);
                                         }
                                     }
                                     myChunk = newChunk(BLOCK_SIZE);
@@ -1752,33 +2215,6 @@ void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFron
                         }
                     }
                 }
-            } else {
-                if (chunkSize < 0) {
-                    // end game message.
-                    if (currChunk->accessCounter >= 2 * frontier->numOfNodes && subworker.isMaster()) {
-                        *endSignal = 1;
-                        printf("master out\n");
-                        shouldFinish = true;
-                        continue;
-                    }
-
-                    if (*localHead >= *localTail && myChunk->m <= 0) {
-                        //forward this to the next node
-                        intT insertPos = __sync_fetch_and_add(insertTail, 1);
-                        nextQueue[insertPos % GA.n] = currChunk;
-                        currChunk->accessCounter++;
-                        while (!__sync_bool_compare_and_swap((intT *)nextTail, insertPos, insertPos+1)) {
-                            if (*nextTail > insertPos) {
-                                break;
-                                printf("pending on insert %d %d %d\n", *nextTail, insertPos, *insertTail);
-                            }
-                        }
-                    } else {
-                        free(currChunk);
-                        *endGameOnFly = 0;
-                    }
-                    continue;
-                }
             }
 
             int oldCounter = __sync_fetch_and_add(&(currChunk->accessCounter), 1);
@@ -1792,6 +2228,8 @@ void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFron
                         bitVec[idx - offset] = 0;
                     } else {
                         bitVec[idx - offset] = 1;
+                        if (myChunk->m == 0)
+                            __sync_fetch_and_add(liveChunks, 1);
                         myChunk->s[myChunk->m] = idx;
                         myChunk->m += 1;
                         if (myChunk->m >= BLOCK_SIZE) {
@@ -1801,7 +2239,7 @@ void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFron
                             while (!__sync_bool_compare_and_swap((intT *)nextTail, insertPos, insertPos+1)) {
                                 if (*nextTail > insertPos) {
                                     break;
-                                    printf("pending on insert %d %d %d\n", *nextTail, insertPos, *insertTail);
+                                    POLYMER_TRACE(LOG_EDGEMAP, "pending on insert %d %d %d\n", *nextTail, insertPos, *insertTail);
                                 }
                             }
                             myChunk = newChunk(BLOCK_SIZE);
@@ -1809,6 +2247,7 @@ void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFron
                     }
                 }
                 free(currChunk);
+                __sync_fetch_and_sub(liveChunks, 1);
             } else {
                 //forward the chunk to next
                 //printf("forward chunk from %d to %d\n", tid, (tid + 1) % frontier->numOfNodes);
@@ -1817,7 +2256,7 @@ void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFron
                 while (!__sync_bool_compare_and_swap((intT *)nextTail, insertPos, insertPos+1)) {
                     if (*nextTail > insertPos) {
                         break;
-                        printf("pending on insert %d %d %d\n", *nextTail, insertPos, *insertTail);
+                        POLYMER_TRACE(LOG_EDGEMAP, "pending on insert %d %d %d\n", *nextTail, insertPos, *insertTail);
                     }
                 }
             }
@@ -1830,7 +2269,7 @@ void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFron
                 while (!__sync_bool_compare_and_swap((intT *)nextTail, insertPos, insertPos+1)) {
                     if (*nextTail > insertPos) {
                         break;
-                        printf("pending on insert %d %d %d\n", *nextTail, insertPos, *insertTail);
+                        POLYMER_TRACE(LOG_EDGEMAP, "pending on insert %d %d %d\n", *nextTail, insertPos, *insertTail);
                     }
 
                 }
@@ -1838,59 +2277,13 @@ void edgeMapSparseAsyncPipe(graph<vertex> GA, vertices *frontier, F f, LocalFron
                 myChunk = newChunk(BLOCK_SIZE);
             }
 
-            if (*endSignal == 1) {
+            // A chunk counts as live from its first vertex until its owner
+            // retires it, and only the holder of a live chunk can start
+            // another, so no live chunk means no work anywhere.
+            if (*liveChunks == 0) {
                 shouldFinish = true;
-            }
-
-            //end game protocol
-            if (subworker.isMaster()) {
-                /*
-                *localSignal = 1;
-                int i = 0;
-                int marker = 1;
-                while (*localSignal == 1) {
-                    //printf("checking\n");
-                    i = (i + 1) % frontier->numOfNodes;
-                    if (*(signals[i]) == 1) {
-                	marker++;
-                    } else {
-                	marker = 0;
-                    }
-                    *(signals[i]) = 1;
-                    if (marker > 3 * frontier->numOfNodes) {
-                	*endSignal = 1;
-                	//printf("master out\n");
-                	shouldFinish = true;
-                	break;
-                    }
-                }
-                */
-
-                // create end game chunk and send it.
-                if (*endGameOnFly == 0) {
-                    printf("sent end game\n");
-                    AsyncChunk *endGameChunk = (AsyncChunk *)malloc(sizeof(AsyncChunk));
-                    endGameChunk->accessCounter = 1;
-                    endGameChunk->m = -1; //magic number for end game chunk.
-                    intT insertPos = __sync_fetch_and_add(insertTail, 1);
-                    nextQueue[insertPos % GA.n] = endGameChunk;
-                    *endGameOnFly = 1;
-                    while (!__sync_bool_compare_and_swap((intT *)nextTail, insertPos, insertPos+1)) {
-                        if (*nextTail > insertPos) {
-                            break;
-                            printf("pending on insert %d %d %d\n", *nextTail, insertPos, *insertTail);
-                        }
-                    }
-                }
             } else {
-                bool firstRound = true;
-                while (*localHead >= *localTail && *endSignal != 1) {
-                    if (firstRound) {
-                        *localSignal = 1;
-                        firstRound = false;
-                    }
-                }
-                *localSignal = 0;
+                while (*localHead >= *localTail && *liveChunks != 0) ;
             }
         }
     }
@@ -1900,7 +2293,7 @@ void switchFrontier(int nodeNum, vertices *V, LocalFrontier* &next);
 
 template <class F, class vertex>
 void edgeMapSparseV5(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, Subworker_Partitioner &subworker = dummyPartitioner) {
-    printf("Polymer - edgeMapSparseV5\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapSparseV5\n");
 
     vertex *V = GA.V;
     intT currM = frontier->numNonzeros();
@@ -1941,7 +2334,7 @@ void edgeMapSparseV5(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
                     lengthOfCurr = frontier->getSparseSize(currNodeNum);
                 }
                 if (currNodeNum >= frontier->numOfNodes || lengthOfCurr <= 0) {
-                    printf("oops\n");
+                    POLYMER_ERROR(LOG_EDGEMAP, "oops\n");
                 }
                 currActiveList = frontier->getSparseArr(currNodeNum);
             }
@@ -1949,7 +2342,7 @@ void edgeMapSparseV5(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
             intT d = V[idx].getFakeDegree();
             for (intT j = 0; j < d; j++) {
                 uintT ngh = V[idx].getOutNeighbor(j);
-                if (f.cond(ngh) && f.updateAtomic(idx, ngh)) {
+                if (functorCond(f, ngh) && f.updateAtomic(idx, ngh)) {
                     next->s[tmp] = ngh;
                     tmp++;
                     nextEdgesCount += V[ngh].getOutDegree();
@@ -1969,7 +2362,7 @@ void edgeMapSparseV5(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
         endPos = currM;
         if (frontier->isEmpty()) {
             if (subworker.tid == 0) {
-                printf("Sparse ok: %d\n", counter);
+                POLYMER_DEBUG(LOG_EDGEMAP, "Sparse ok: %d\n", counter);
             }
             break;
         }
@@ -1979,7 +2372,7 @@ void edgeMapSparseV5(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
 
 template <class F, class vertex>
 void edgeMapSparseV4(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, bool firstTime = false, Subworker_Partitioner &subworker = dummyPartitioner) {
-    printf("Polymer - edgeMapSparseV4\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapSparseV4\n");
 
     // in V4, all thread has its own chunk.
     vertex *V = GA.V;
@@ -2014,7 +2407,7 @@ void edgeMapSparseV4(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
                         lengthOfCurr = frontier->getSparseSize(currNodeNum);
                     }
                     if (currNodeNum >= frontier->numOfNodes || lengthOfCurr <= 0) {
-                        printf("oops\n");
+                        POLYMER_ERROR(LOG_EDGEMAP, "oops\n");
                     }
                     currActiveList = frontier->getSparseArr(currNodeNum);
                 }
@@ -2022,7 +2415,7 @@ void edgeMapSparseV4(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
                 intT d = V[idx].getFakeDegree();
                 for (intT j = 0; j < d; j++) {
                     uintT ngh = V[idx].getOutNeighbor(j);
-                    if (f.cond(ngh) && f.updateAtomic(idx, ngh)) {
+                    if (functorCond(f, ngh) && f.updateAtomic(idx, ngh)) {
                         nextChunk[nextM] = ngh;
                         nextM++;
                         nextEdgesCount += V[ngh].getOutDegree();
@@ -2056,7 +2449,7 @@ void edgeMapSparseV4(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
                 intT d = V[idx].getFakeDegree();
                 for (intT j = 0; j < d; j++) {
                     uintT ngh = V[idx].getOutNeighbor(j);
-                    if (f.cond(ngh) && f.updateAtomic(idx, ngh)) {
+                    if (functorCond(f, ngh) && f.updateAtomic(idx, ngh)) {
                         nextChunk[nextM] = ngh;
                         nextM++;
                         nextEdgesCount += V[ngh].getOutDegree();
@@ -2075,88 +2468,177 @@ void edgeMapSparseV4(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
     }
 }
 
+// Traversal of the frontier vertices [vBegin, currM) of edgeMapSparseV3,
+// over the edges [eBegin, eEnd) of the frontier (eEnd -1 for all), edge
+// eBegin being edge jBegin of vertex vBegin.  Positions are those of the
+// degree prefix, so every subworker stops where the next one starts.
+// Every vertex costs a chain of dependent misses: its record, then its
+// adjacency list, then the state of each neighbour.  The vertices run in
+// groups through a hand-unrolled pipeline whose stages each walk the whole
+// group, prefetching what the next stage dereferences, so a group keeps one
+// miss per vertex in flight at each step of the chain.
+template <class F, class vertex>
+inline void edgeMapSparseInterleaved(vertex *V, F &f, vertices *frontier, LocalFrontier *next, int subTid,
+                                     intT vBegin, intT jBegin, intT eBegin, intT eEnd, intT currM, intT &nextM, intT &nextEdgesCount,
+                                     intT &edgesVisited) {
+    const PrefetchConfig &config = prefetchConfig();
+    int group = config.sparseGroup;
+    intT ids[SPARSE_GROUP_MAX];
+    intT from[SPARSE_GROUP_MAX];
+    intT to[SPARSE_GROUP_MAX];
+
+    SparseCursor cursor(frontier, vBegin);
+    intT e = eBegin - jBegin; // position of the first edge of the next vertex
+    bool done = false;
+    for (intT i = vBegin; i < currM && !done; i += group) {
+        // frontier ids, prefetch the vertex records
+        int n = 0;
+        for (; n < group && i + n < currM; n++) {
+            ids[n] = cursor.next();
+            __builtin_prefetch(&V[ids[n]], 0, 3);
+        }
+        // edge ranges, prefetch the adjacency lists
+        int m = 0;
+        for (; m < n; m++) {
+            if (eEnd >= 0 && e >= eEnd) {
+                done = true;
+                break;
+            }
+            intT d = V[ids[m]].getFakeDegree();
+            from[m] = (i + m == vBegin) ? jBegin : 0;
+            to[m] = (eEnd >= 0 && eEnd - e < d) ? eEnd - e : d;
+            e += d;
+            if (from[m] < to[m]) {
+                edgesVisited += to[m] - from[m];
+                __builtin_prefetch(V[ids[m]].getOutNeighborPtr() + from[m], 0, 3);
+            }
+        }
+        // prefetch the state of the first neighbours
+        for (int k = 0; k < m; k++) {
+            intT ahead = (to[k] - from[k] < config.distance) ? to[k] : from[k] + config.distance;
+            for (intT j = from[k]; j < ahead; j++) {
+                intT ngh = V[ids[k]].getOutNeighbor(j);
+                __builtin_prefetch(f.nextPrefetchAddr(ngh), 1, 3);
+            }
+        }
+        // the updates, prefetching further down long adjacency lists
+        for (int k = 0; k < m; k++) {
+            intT idx = ids[k];
+            for (intT j = from[k]; j < to[k]; j++) {
+                if (j + config.distance < to[k])
+                    __builtin_prefetch(f.nextPrefetchAddr(V[idx].getOutNeighbor(j + config.distance)), 1, 3);
+                uintT ngh = V[idx].getOutNeighbor(j);
+                if (functorCond(f, ngh) && f.updateAtomic(idx, ngh) && FunctorTraits<F>::producesFrontier) {
+                    next->pushSub(subTid, nextM, ngh);
+                    nextEdgesCount += V[ngh].getOutDegree();
+                }
+            }
+        }
+    }
+}
+
 template <class F, class vertex>
 void edgeMapSparseV3(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, bool part = false, Subworker_Partitioner &subworker = dummyPartitioner) {
-    printf("Polymer - edgeMapSparseV3\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapSparseV3\n");
 
     vertex *V = GA.V;
     if (part) {
         intT currM = frontier->numNonzeros();
-        int startPos = subworker.getStartPos(currM);
-        int endPos = subworker.getEndPos(currM);
+        int subTid = subworker.subTid;
+        int numOfSub = subworker.numOfSub;
 
-        intT *mPtr = &(next->m);
-        *mPtr = 0;
+        // every subworker appends to its own node-local buffer, kept across
+        // iterations; mergeSubBuffers concatenates them into next->s
         next->outEdgesCount = 0;
-        int bufferLen = frontier->getEdgeStat();
-        if (subworker.isSubMaster())
-            next->s = (intT *)malloc(sizeof(intT) * bufferLen);
+        if (subworker.isSubMaster()) {
+            next->reserveSubArrays(numOfSub);
+            next->reserveSparse(frontier->getEdgeStat());
+            next->reservePrefix(currM + 1);
+        }
         intT nextEdgesCount = 0;
+        intT nextM = 0;
 
         //pthread_barrier_wait(subworker.local_barr);
         subworker.localWait();
-        intT *nextFrontier = next->s;
 
-        if (startPos < endPos) {
-            //printf("have ele: %d to %d %d, %p\n", startPos, endPos, subworker.tid, next);
-            int currNodeNum = frontier->getNodeNumOfSparseIndex(startPos);
-            int offset = 0;
-            for (int i = 0; i < currNodeNum; i++) {
-                offset += frontier->getSparseSize(i);
-            }
-            intT *currActiveList = frontier->getSparseArr(currNodeNum);
-            int lengthOfCurr = frontier->getSparseSize(currNodeNum) - (startPos - offset);
-            //printf("nodeNum of %d %d: %d from %d to %d\n", subworker.tid, subworker.subTid, currNodeNum, startPos, endPos);
-            for (int i = startPos; i < endPos; i++) {
-                if (lengthOfCurr <= 0) {
-                    while (currNodeNum + 1 < frontier->numOfNodes && lengthOfCurr <= 0) {
-                        offset += frontier->getSparseSize(currNodeNum);
-                        currNodeNum++;
-                        lengthOfCurr = frontier->getSparseSize(currNodeNum);
-                        //printf("lengthOfCurr: %d\n", lengthOfCurr);
-                    }
-                    if (currNodeNum >= frontier->numOfNodes || lengthOfCurr <= 0) {
-                        printf("oops\n");
-                    }
-                    currActiveList = frontier->getSparseArr(currNodeNum);
-                    //printf("currList of %d %d: %p\n", subworker.tid, subworker.subTid, currActiveList);
-                }
-                //printf("s: %p %d\n", currActiveList, i-offset);
-                intT idx = currActiveList[i - offset];
-                //printf("vertex on %d %d: %d\n", subworker.tid, subworker.subTid, idx);
-                intT d = V[idx].getFakeDegree();
-                //printf("degree: %d\n", d);
-                for (intT j = 0; j < d; j++) {
-                    uintT ngh = V[idx].getOutNeighbor(j);
-                    if (f.cond(ngh) && f.updateAtomic(idx, ngh)) {
-                        //add to active list
-                        //printf("out edge # %d: %d -> %d of %d %d\n", nextM, idx, ngh, subworker.tid, subworker.subTid);
-                        /*
-                        if (nextM >= bufferLen) {
-                            printf("oops: %d %d\n", subworker.tid, subworker.subTid);
-                        }
-                        */
-                        //printf("I am here\n");
-                        int tmp = __sync_fetch_and_add(mPtr, 1);
-                        if (tmp >= bufferLen)
-                            printf("oops\n");
-                        nextFrontier[tmp] = ngh;
-                        nextEdgesCount += V[ngh].getOutDegree();
-                    }
+        // Split the frontier by edges rather than by vertices, so that the
+        // adjacency of a hub is shared by the subworkers of the node.  The
+        // degree prefix is built in parallel over vertex slices, then every
+        // subworker takes an equal range of edges and finds its first vertex
+        // by binary search (merge-path).
+        intT vBegin = 0;
+        intT jBegin = 0;
+        intT eBegin = 0;
+        intT eEnd = 0;
+        if (numOfSub > 1) {
+            intT *degPrefix = next->degPrefix;
+            intT startPos = subworker.getStartPos(currM);
+            intT endPos = subworker.getEndPos(currM);
+            intT sum = 0;
+            if (startPos < endPos) {
+                SparseCursor cursor(frontier, startPos);
+                for (intT i = startPos; i < endPos; i++) {
+                    sum += V[cursor.next()].getFakeDegree();
+                    degPrefix[i + 1] = sum;
                 }
-                lengthOfCurr--;
-                //printf("nextM: %d %d\n", nextM, nextEdgesCount);
             }
-        }
+            next->subCounts[subTid] = sum;
+            subworker.localWait();
+            intT base = 0;
+            for (int i = 0; i < subTid; i++) {
+                base += next->subCounts[i];
+            }
+            for (intT i = startPos; i < endPos; i++) {
+                degPrefix[i + 1] += base;
+            }
+            if (subworker.isSubMaster())
+                degPrefix[0] = 0;
+            subworker.localWait();
+
+            intT totalEdges = degPrefix[currM];
+            intT chunk = totalEdges / numOfSub;
+            eBegin = subTid * chunk;
+            eEnd = (subTid == numOfSub - 1) ? totalEdges : eBegin + chunk;
+            if (eBegin < eEnd) {
+                vBegin = (intT)(std::upper_bound(degPrefix, degPrefix + currM + 1, eBegin) - degPrefix) - 1;
+                jBegin = eBegin - degPrefix[vBegin];
+            } else {
+                vBegin = currM;
+            }
+        } else {
+            eEnd = -1; // a single subworker takes every edge
+        }
+
+        intT edgesVisited = 0;
+        if (vBegin < currM) {
+            edgeMapSparseInterleaved(V, f, frontier, next, subTid, vBegin, jBegin, eBegin, eEnd, currM, nextM, nextEdgesCount, edgesVisited);
+        }
+#if POLYMER_LOG_LEVEL >= POLYMER_LOG_DEBUG
+        // the edge ranges of the subworkers must tile the frontier's edges
+        if (numOfSub > 1) {
+            if (edgesVisited != ((eBegin < eEnd) ? eEnd - eBegin : 0))
+                POLYMER_ERROR(LOG_EDGEMAP, "oops: subworker %d of node %d visited %d edges of [%d, %d)\n", subTid, subworker.tid, edgesVisited, eBegin, eEnd);
+            next->subCounts[subTid] = edgesVisited;
+            subworker.localWait();
+            if (subworker.isSubMaster()) {
+                intT visited = 0;
+                for (int i = 0; i < numOfSub; i++)
+                    visited += next->subCounts[i];
+                if (visited != next->degPrefix[currM])
+                    POLYMER_ERROR(LOG_EDGEMAP, "oops: sparse edgeMap of node %d visited %d of %d edges\n", subworker.tid, visited, next->degPrefix[currM]);
+            }
+            subworker.localWait();
+        }
+#endif
         __sync_fetch_and_add(&(next->outEdgesCount), nextEdgesCount);
         //pthread_barrier_wait(subworker.local_barr);
-        subworker.localWait();
+        next->mergeSubBuffers(subworker, nextM);
     }
 }
 
 template <class F, class vertex>
 void edgeMapSparseV2(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *next, bool part = false, Subworker_Partitioner &subworker = dummyPartitioner) {
-    printf("Polymer - edgeMapSparseV2\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapSparseV2\n");
 
     vertex *V = GA.V;
     if (part) {
@@ -2191,7 +2673,7 @@ void edgeMapSparseV2(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
                         //printf("lengthOfCurr: %d\n", lengthOfCurr);
                     }
                     if (currNodeNum >= frontier->numOfNodes || lengthOfCurr <= 0) {
-                        printf("oops\n");
+                        POLYMER_ERROR(LOG_EDGEMAP, "oops\n");
                     }
                     currActiveList = frontier->getSparseArr(currNodeNum);
                     //printf("currList of %d %d: %p\n", subworker.tid, subworker.subTid, currActiveList);
@@ -2202,11 +2684,11 @@ void edgeMapSparseV2(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
                 intT d = V[idx].getFakeDegree();
                 for (intT j = 0; j < d; j++) {
                     uintT ngh = V[idx].getOutNeighbor(j);
-                    if (f.cond(ngh) && f.updateAtomic(idx, ngh)) {
+                    if (functorCond(f, ngh) && f.updateAtomic(idx, ngh)) {
                         //add to active list
                         //printf("out edge # %d: %d -> %d of %d %d\n", nextM, idx, ngh, subworker.tid, subworker.subTid);
                         if (nextM >= bufferLen) {
-                            printf("oops: %d %d\n", subworker.tid, subworker.subTid);
+                            POLYMER_ERROR(LOG_EDGEMAP, "oops: %d %d\n", subworker.tid, subworker.subTid);
                         }
                         nextFrontier[nextM] = ngh;
                         nextM++;
@@ -2253,7 +2735,7 @@ void edgeMapSparseV2(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
             for (intT i = 0; i < nextM; i++) {
                 next->s[i+fillOffset] = nextFrontier[i];
                 if (i + fillOffset >= next->m) {
-                    printf("oops\n");
+                    POLYMER_ERROR(LOG_EDGEMAP, "oops\n");
                 }
                 //printf("filled to %d of %d: %d\n", i + fillOffset, subworker.tid, nextFrontier[i]);
             }
@@ -2293,7 +2775,7 @@ void edgeMapSparseV2(graph<vertex> GA, vertices *frontier, F f, LocalFrontier *n
 
 template <class F, class Vert_F, class vertex>
 void edgeMapSparse(graph<vertex> GA, vertices *frontier, F f, Vert_F vf, LocalFrontier *next, Subworker_Partitioner &subworker=dummyPartitioner) {
-    printf("Polymer - edgeMapSparse\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMapSparse\n");
 
     vertex *V = GA.V;
     intT sparseIter = 0;
@@ -2325,7 +2807,7 @@ void edgeMapSparse(graph<vertex> GA, vertices *frontier, F f, Vert_F vf, LocalFr
                 degrees[i] = V[sparseQueue[i]].getOutDegree();
             }
         }
-        printf("sparse: %d\n", totM);
+        POLYMER_DEBUG(LOG_EDGEMAP, "sparse: %d\n", totM);
         //printf("in loop : %d %p\n", frontier->numOfNodes, frontierOffsets);
         uintT *offsets = (uintT *)degrees;
         uintT outEdgeCount = sequence::plusScan(offsets, (uintT *)degrees, (uintT)totM);
@@ -2339,7 +2821,7 @@ void edgeMapSparse(graph<vertex> GA, vertices *frontier, F f, Vert_F vf, LocalFr
                 if (d < 1000) {
                     for (intT j = 0; j < d; j++) {
                         intT ngh = vert.getOutNeighbor(j);
-                        if (f.cond(ngh) && f.updateAtomic(v, ngh))
+                        if (functorCond(f, ngh) && f.updateAtomic(v, ngh))
                             outEdges[o+j] = ngh;
                         else
                             outEdges[o+j] = -1;
@@ -2347,7 +2829,7 @@ void edgeMapSparse(graph<vertex> GA, vertices *frontier, F f, Vert_F vf, LocalFr
                 } else {
                     {   parallel_for (intT j = 0; j < d; j++) {
                             intT ngh = vert.getOutNeighbor(j);
-                            if (f.cond(ngh) && f.updateAtomic(v, ngh))
+                            if (functorCond(f, ngh) && f.updateAtomic(v, ngh))
                                 outEdges[o+j] = ngh;
                             else
                                 outEdges[o+j] = -1;
@@ -2361,7 +2843,7 @@ void edgeMapSparse(graph<vertex> GA, vertices *frontier, F f, Vert_F vf, LocalFr
         intT* nextIndices = (intT *)malloc(sizeof(intT) * outEdgeCount);
         newM = sequence::filter(outEdges, nextIndices, outEdgeCount, nonNegF());
         if (newM <= 0) {
-            printf("sparseIter: %d %d\n", sparseIter, newM);
+            POLYMER_DEBUG(LOG_EDGEMAP, "sparseIter: %d %d\n", sparseIter, newM);
             break;
         } else {
             if (sparseQueue != NULL) {
@@ -2380,7 +2862,7 @@ void edgeMapSparse(graph<vertex> GA, vertices *frontier, F f, Vert_F vf, LocalFr
 static int edgesTraversed = 0;
 
 void switchFrontier(int nodeNum, vertices *V, LocalFrontier* &next) {
-    printf("Polymer - switchFrontier\n");
+    POLYMER_TRACE(LOG_FRONTIER, "Polymer - switchFrontier\n");
 
     LocalFrontier *current = V->getFrontier(nodeNum);
     intT size = V->getSize(nodeNum);
@@ -2401,7 +2883,7 @@ void clearLocalFrontier(LocalFrontier *next, int nodeNum, int subNum, int totalS
 template <class F, class vertex>
 void edgeMap(graph<vertex> GA, vertices *V, F f, LocalFrontier *next, intT threshold = -1,
              char option=DENSE, bool remDups=false, bool part = false, Subworker_Partitioner &subworker = dummyPartitioner) {
-    printf("Polymer - edgeMap\n");
+    POLYMER_TRACE(LOG_EDGEMAP, "Polymer - edgeMap\n");
 
     intT numVertices = GA.n;
     uintT numEdges = GA.m;
@@ -2419,12 +2901,12 @@ void edgeMap(graph<vertex> GA, vertices *V, F f, LocalFrontier *next, intT thres
     int start = subworker.dense_start;
     int end = subworker.dense_end;
 
-    if (m >= threshold) {
+    if (V->useDense(subworker, m, threshold)) {
         //Dense part
         if (subworker.isMaster()) {
-            printf("Dense: %d\n", m);
-            V->toDense();
+            POLYMER_DEBUG(LOG_EDGEMAP, "Dense: %lld\n", m);
         }
+        V->toDense(subworker);
 
         if (subworker.isSubMaster()) {
             next->sparseCounter = 0;
@@ -2434,19 +2916,21 @@ void edgeMap(graph<vertex> GA, vertices *V, F f, LocalFrontier *next, intT thres
 
         //pthread_barrier_wait(subworker.global_barr);
         subworker.globalWait();
+        long long kernelStart = V->kernelStart(subworker);
 
         bool* R = (option == DENSE_FORWARD) ?
                   edgeMapDenseForward(GA, V, f, next, part, start, end) :
                   //edgeMapDenseForwardDynamic(GA, V, f, next, subworker) :
                   //edgeMapDense(GA, V, f, next, option, subworker);
                   edgeMapDenseDynamic(GA, V, f, next, subworker);
+        V->kernelEnd(subworker, kernelStart);
         next->isDense = true;
     } else {
         //Sparse part
         if (subworker.isMaster()) {
-            printf("Sparse: %d %d\n", V->numNonzeros(), m);
-            V->toSparse();
+            POLYMER_DEBUG(LOG_EDGEMAP, "Sparse: %d %lld\n", V->numNonzeros(), m);
         }
+        V->toSparse(subworker);
         /*
         if (subworker.isSubMaster()) {
             if (next->sparseChunks == NULL) {
@@ -2459,11 +2943,13 @@ void edgeMap(graph<vertex> GA, vertices *V, F f, LocalFrontier *next, intT thres
         */
         //pthread_barrier_wait(subworker.global_barr);
         subworker.globalWait();
+        long long kernelStart = V->kernelStart(subworker);
         if (V->firstSparse && subworker.isMaster()) {
-            printf("my first sparse\n");
+            POLYMER_DEBUG(LOG_EDGEMAP, "my first sparse\n");
         }
 
         edgeMapSparseV3(GA, V, f, next, part, subworker);
+        V->kernelEnd(subworker, kernelStart);
         //edgeMapSparseV4(GA, V, f, next, V->firstSparse, subworker);
         //edgeMapSparseV5(GA, V, f, next, subworker);
         next->isDense = false;
@@ -2473,13 +2959,25 @@ void edgeMap(graph<vertex> GA, vertices *V, F f, LocalFrontier *next, intT thres
 //*****VERTEX FUNCTIONS*****
 template<class vertex>
 void vertexCounter(graph<vertex> GA, LocalFrontier *frontier, int nodeNum, int subNum, int totalSub) {
-    printf("Polymer - vertexCounter\n");
+    POLYMER_TRACE(LOG_VERTEXMAP, "Polymer - vertexCounter\n");
 
     if (!frontier->isDense)
         return;
 
     int size = frontier->endID - frontier->startID;
     int offset = frontier->startID;
+    if (frontier->isBitmap()) {
+        intT lo, hi;
+        bitmapSlice(size, subNum, totalSub, lo, hi);
+        intT outEdges = 0;
+        for (intT w = lo; w < hi; w++) {
+            for (bitWord word = frontier->bits[w]; word != 0; word &= word - 1)
+                outEdges += GA.V[w * BITMAP_WORD_BITS + __builtin_ctzll(word) + offset].getOutDegree();
+        }
+        __sync_fetch_and_add(&(frontier->m), bitmapCountWords(frontier->bits, lo, hi));
+        __sync_fetch_and_add(&(frontier->outEdgesCount), outEdges);
+        return;
+    }
     bool *b = frontier->b;
     int subSize = size / totalSub;
     int startPos = subSize * subNum;
@@ -2503,10 +3001,18 @@ void vertexCounter(graph<vertex> GA, LocalFrontier *frontier, int nodeNum, int s
 
 template <class F>
 void vertexMap(vertices *V, F add, int nodeNum) {
-    printf("Polymer - vertexMap - Def#1\n");
+    POLYMER_TRACE(LOG_VERTEXMAP, "Polymer - vertexMap - Def#1\n");
 
     int size = V->getSize(nodeNum);
     int offset = V->getOffset(nodeNum);
+    if (V->getFrontier(nodeNum)->isBitmap()) {
+        bitWord *bits = V->getFrontier(nodeNum)->bits;
+        for (intT w = 0; w < bitmapWords(size); w++) {
+            for (bitWord word = bits[w]; word != 0; word &= word - 1)
+                add(w * BITMAP_WORD_BITS + __builtin_ctzll(word) + offset);
+        }
+        return;
+    }
     bool *b = V->getArr(nodeNum);
     for (int i = 0; i < size; i++) {
         if (b[i])
@@ -2516,9 +3022,18 @@ void vertexMap(vertices *V, F add, int nodeNum) {
 
 template <class F>
 void vertexMap(vertices *V, F add, int nodeNum, int subNum, int totalSub) {
-    printf("Polymer - vertexMap - Def#2\n");
+    POLYMER_TRACE(LOG_VERTEXMAP, "Polymer - vertexMap - Def#2\n");
 
-    if (V->isDense) {
+    if (V->isDense && V->getFrontier(nodeNum)->isBitmap()) {
+        intT lo, hi;
+        int offset = V->getOffset(nodeNum);
+        bitmapSlice(V->getSize(nodeNum), subNum, totalSub, lo, hi);
+        bitWord *bits = V->getFrontier(nodeNum)->bits;
+        for (intT w = lo; w < hi; w++) {
+            for (bitWord word = bits[w]; word != 0; word &= word - 1)
+                add(w * BITMAP_WORD_BITS + __builtin_ctzll(word) + offset);
+        }
+    } else if (V->isDense) {
         int size = V->getSize(nodeNum);
         int offset = V->getOffset(nodeNum);
         bool *b = V->getArr(nodeNum);
@@ -2548,11 +3063,35 @@ void vertexMap(vertices *V, F add, int nodeNum, int subNum, int totalSub) {
     }
 }
 
+// vertexMap over every vertex of the node, whatever its frontier holds
+template <class F>
+void vertexMapAll(vertices *V, F add, int nodeNum, int subNum, int totalSub) {
+    POLYMER_TRACE(LOG_VERTEXMAP, "Polymer - vertexMapAll\n");
+
+    int size = V->getSize(nodeNum);
+    int offset = V->getOffset(nodeNum);
+    int subSize = size / totalSub;
+    int startPos = subSize * subNum;
+    int endPos = subSize * (subNum + 1);
+    if (subNum == totalSub - 1) {
+        endPos = size;
+    }
+    for (int i = startPos; i < endPos; i++) {
+        add(i + offset);
+    }
+}
+
 void clearLocalFrontier(LocalFrontier *next, int nodeNum, int subNum, int totalSub) {
-    printf("Polymer - clearLocalFrontier\n");
+    POLYMER_TRACE(LOG_FRONTIER, "Polymer - clearLocalFrontier\n");
 
     int size = next->endID - next->startID;
     //int offset = V->getOffset(nodeNum);
+    if (next->isBitmap()) {
+        intT lo, hi;
+        bitmapSlice(size, subNum, totalSub, lo, hi);
+        bitmapClearWords(next->bits, lo, hi);
+        return;
+    }
     bool *b = next->b;
     int subSize = size / totalSub;
     int startPos = subSize * subNum;
@@ -2568,7 +3107,7 @@ void clearLocalFrontier(LocalFrontier *next, int nodeNum, int subNum, int totalS
 
 template <class F>
 void vertexFilter(vertices *V, F filter, int nodeNum, bool *result) {
-    printf("Polymer - vertexFilter - Def#1\n");
+    POLYMER_TRACE(LOG_VERTEXMAP, "Polymer - vertexFilter - Def#1\n");
 
     int size = V->getSize(nodeNum);
     int offset = V->getOffset(nodeNum);
@@ -2582,7 +3121,7 @@ void vertexFilter(vertices *V, F filter, int nodeNum, bool *result) {
 
 template <class F>
 void vertexFilter(vertices *V, F filter, int nodeNum, int subNum, int totalSub, LocalFrontier *result) {
-    printf("Polymer - vertexFilter - Def#2\n");
+    POLYMER_TRACE(LOG_VERTEXMAP, "Polymer - vertexFilter - Def#2\n");
 
     int size = V->getSize(nodeNum);
     int offset = V->getOffset(nodeNum);
@@ -2594,6 +3133,22 @@ void vertexFilter(vertices *V, F filter, int nodeNum, int subNum, int totalSub,
         endPos = size;
     }
 
+    if (result->isBitmap() || V->getFrontier(nodeNum)->isBitmap()) {
+        FrontierBits src = V->getBits(nodeNum);
+        FrontierBits dst = result->view();
+        int m = 0;
+        for (int i = startPos; i < endPos; i++) {
+            if (src.get(i) && filter(i + offset)) {
+                dst.set(i);
+                m++;
+            } else {
+                result->setBit(i + offset, false);
+            }
+        }
+        writeAdd(&(result->m), m);
+        return;
+    }
+
     bool *dst = result->b;
     int m = 0;
     /*
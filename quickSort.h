@@ -43,10 +43,13 @@ E median(E a, E b, E c, BinPred f) {
            : (f(a,c) ? a : (f(b,c) ? c : b));
 }
 
+// below this size the two halves are sorted by the same task
+#define QSORT_TASK_CUTOFF 4096
+
 // Quicksort based on median of three elements as pivot
 //  and uses insertionSort for small inputs
 template <class E, class BinPred, class intT>
-void quickSort(E* A, intT n, BinPred f) {
+void quickSortRec(E* A, intT n, BinPred f) {
   if (n < ISORT) insertionSort(A, n, f);
   else {
     //E p = std::__median(A[n/4],A[n/2],A[(3*n)/4],f);
@@ -66,10 +69,31 @@ void quickSort(E* A, intT n, BinPred f) {
       if (f(*M,p)) std::swap(*M,*(L++));
       M++;
     }
-    cilk_spawn quickSort(A, L-A, f);
-    quickSort(M, A+n-M, f); // Exclude all elts that equal pivot
+#if defined(OPENMP)
+#pragma omp task if (L-A > QSORT_TASK_CUTOFF)
+    quickSortRec(A, L-A, f);
+    quickSortRec(M, A+n-M, f); // Exclude all elts that equal pivot
+#pragma omp taskwait
+#else
+    cilk_spawn quickSortRec(A, L-A, f);
+    quickSortRec(M, A+n-M, f); // Exclude all elts that equal pivot
     cilk_sync;
+#endif
+  }
+}
+
+template <class E, class BinPred, class intT>
+void quickSort(E* A, intT n, BinPred f) {
+#if defined(OPENMP)
+  // tasks need an enclosing team, open one unless we are already in one
+  if (!omp_in_parallel() && n > QSORT_TASK_CUTOFF) {
+#pragma omp parallel num_threads(parallel_workers())
+#pragma omp single nowait
+    quickSortRec(A, n, f);
+    return;
   }
+#endif
+  quickSortRec(A, n, f);
 }
 
 #endif // _A_QSORT_INCLUDED